@@ -21,10 +21,12 @@ void solve_transport_2d(
     const int* neighbours, Particle* particles, const double* density,
     const double* edgex, const double* edgey, const double* edgedx,
     const double* edgedy, CrossSection* cs_scatter_table,
-    CrossSection* cs_absorb_table, double* energy_deposition_tally,
-    uint64_t* nfacets_reduce_array, uint64_t* ncollisions_reduce_array,
+    CrossSection* cs_absorb_table, CrossSection* cs_unionized_table,
+    double* energy_deposition_tally, double* scalar_flux_tally,
+    uint64_t* nfacets_reduce_array,
+    uint64_t* ncollisions_reduce_array,
     uint64_t* nprocessed_reduce_array, uint64_t* facet_events,
-    uint64_t* collision_events) {
+    uint64_t* collision_events, TransportOptions* options) {
 
   // This is the known starting number of particles
   int nparticles = *nlocal_particles;
@@ -0,0 +1,430 @@
+#include "neutral_data.h"
+#include "../comms.h"
+#include "../shared.h"
+#include "neutral_interface.h"
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef MPI
+#include "mpi.h"
+#endif
+
+// The imbalance below which the decomposition is left unchanged
+#define LOAD_IMBALANCE_TOLERANCE 1.05
+
+// The fraction of the mean cost given to every cell, so that the cells
+// without any events are still shared out between the ranks
+#define CELL_COST_FLOOR 1.0e-3
+
+#ifdef MPI
+// The cells of the mesh owned by a rank
+typedef struct {
+  int x_off;
+  int y_off;
+  int nx;
+  int ny;
+
+} Partition;
+
+// Places the cuts between nparts partitions of n cells, such that each
+// partition has a similar cost and is at least min_width cells wide
+static void partition_axis(const int n, const int nparts, const int min_width,
+                           const double* cost, int* cuts);
+
+// Determines the cells that two partitions have in common
+static int overlap(const Partition* a, const Partition* b, Partition* common);
+
+// Estimates the cost of a partition from the costs measured by every rank,
+// assuming that each rank's cost was spread evenly over its cells
+static double estimate_cost(const int nranks, const Partition* before,
+                            const double* costs, const Partition* partition);
+
+// Moves the cells of a field from the old to the new partitions, where the
+// field is reallocated to fit the new partition of the rank
+static void move_cells(const int rank, const int nranks, const int pad,
+                       const Partition* before, const Partition* after,
+                       double** field);
+
+// Sends every particle to the rank whose new partition contains its cell
+static void move_particles(const int rank, const int nranks, const int px,
+                           const int py, const int* cutx, const int* cuty,
+                           const int* owner, const int capacity,
+                           int* nparticles, Particle* particles);
+#endif
+
+// Repartitions the mesh between the ranks by the cost each rank measured over
+// the last timestep, moving the tallies, density and particles to match
+void balance_load(NeutralData* neutral_data, Mesh* mesh, double** density,
+                  const uint64_t cost) {
+
+#ifdef MPI
+  const double balance_start = omp_get_wtime();
+  const int rank = mesh->rank;
+  const int nranks = mesh->nranks;
+  const int pad = mesh->pad;
+
+  Partition* before = (Partition*)malloc(sizeof(Partition) * nranks);
+  Partition* after = (Partition*)malloc(sizeof(Partition) * nranks);
+  double* costs = (double*)malloc(sizeof(double) * nranks);
+  double* cost_x = (double*)calloc(mesh->global_nx, sizeof(double));
+  double* cost_y = (double*)calloc(mesh->global_ny, sizeof(double));
+  int* owner = (int*)malloc(sizeof(int) * nranks);
+  if (!before || !after || !costs || !cost_x || !cost_y || !owner) {
+    TERMINATE("Could not allocate the load balancing data.\n");
+  }
+
+  // Gather the partition and the cost of every rank
+  const Partition local = {mesh->x_off, mesh->y_off, mesh->local_nx - 2 * pad,
+                           mesh->local_ny - 2 * pad};
+  const double local_cost = (double)cost;
+  MPI_Allgather(&local, 4, MPI_INT, before, 4, MPI_INT, MPI_COMM_WORLD);
+  MPI_Allgather(&local_cost, 1, MPI_DOUBLE, costs, 1, MPI_DOUBLE,
+                MPI_COMM_WORLD);
+
+  double total_cost = 0.0;
+  double peak_cost = 0.0;
+  for (int rr = 0; rr < nranks; ++rr) {
+    total_cost += costs[rr];
+    peak_cost = max(peak_cost, costs[rr]);
+  }
+  const double imbalance =
+      (total_cost > 0.0) ? peak_cost * nranks / total_cost : 1.0;
+
+  if (imbalance < LOAD_IMBALANCE_TOLERANCE) {
+    if (rank == MASTER) {
+      printf("Imbalance  %.3f, decomposition kept\n", imbalance);
+    }
+    free(before);
+    free(after);
+    free(costs);
+    free(cost_x);
+    free(cost_y);
+    free(owner);
+    return;
+  }
+
+  // The cost profile along each axis, with every cell given a minimum cost
+  for (int ii = 0; ii < mesh->global_nx; ++ii) {
+    cost_x[ii] = CELL_COST_FLOOR * total_cost / mesh->global_nx;
+  }
+  for (int jj = 0; jj < mesh->global_ny; ++jj) {
+    cost_y[jj] = CELL_COST_FLOOR * total_cost / mesh->global_ny;
+  }
+  for (int rr = 0; rr < nranks; ++rr) {
+    for (int ii = 0; ii < before[rr].nx; ++ii) {
+      cost_x[before[rr].x_off + ii] += costs[rr] / before[rr].nx;
+    }
+    for (int jj = 0; jj < before[rr].ny; ++jj) {
+      cost_y[before[rr].y_off + jj] += costs[rr] / before[rr].ny;
+    }
+  }
+
+  // The ranks form a grid, so the ranks in a column share the cuts in x and
+  // the ranks in a row share the cuts in y, and the neighbours are unchanged
+  int px = 0;
+  int py = 0;
+  for (int rr = 0; rr < nranks; ++rr) {
+    px += (before[rr].y_off == 0);
+    py += (before[rr].x_off == 0);
+  }
+
+  int* cutx = (int*)malloc(sizeof(int) * (px + 1));
+  int* cuty = (int*)malloc(sizeof(int) * (py + 1));
+  if (!cutx || !cuty) {
+    TERMINATE("Could not allocate the load balancing data.\n");
+  }
+  partition_axis(mesh->global_nx, px, max(1, pad), cost_x, cutx);
+  partition_axis(mesh->global_ny, py, max(1, pad), cost_y, cuty);
+
+  double predicted_peak_cost = 0.0;
+  for (int rr = 0; rr < nranks; ++rr) {
+    int col = 0;
+    int row = 0;
+    for (int ss = 0; ss < nranks; ++ss) {
+      col += (before[ss].y_off == 0 && before[ss].x_off < before[rr].x_off);
+      row += (before[ss].x_off == 0 && before[ss].y_off < before[rr].y_off);
+    }
+    after[rr].x_off = cutx[col];
+    after[rr].y_off = cuty[row];
+    after[rr].nx = cutx[col + 1] - cutx[col];
+    after[rr].ny = cuty[row + 1] - cuty[row];
+    owner[row * px + col] = rr;
+
+    predicted_peak_cost = max(predicted_peak_cost,
+                              estimate_cost(nranks, before, costs, &after[rr]));
+  }
+
+  // Move the cell data to the new partitions, where the energy deposition and
+  // scalar flux tallies are unpadded
+  move_cells(rank, nranks, 0, before, after,
+             &neutral_data->energy_deposition_tally);
+  if (neutral_data->scalar_flux_tally) {
+    move_cells(rank, nranks, 0, before, after,
+               &neutral_data->scalar_flux_tally);
+  }
+  move_cells(rank, nranks, pad, before, after, density);
+  neutral_data->tally_nx = after[rank].nx;
+  neutral_data->tally_ny = after[rank].ny;
+
+  // The mesh is rebuilt for the new partition, and the halo refreshed
+  mesh->x_off = after[rank].x_off;
+  mesh->y_off = after[rank].y_off;
+  mesh->local_nx = after[rank].nx + 2 * pad;
+  mesh->local_ny = after[rank].ny + 2 * pad;
+  deallocate_data(mesh->edgex);
+  deallocate_data(mesh->edgey);
+  deallocate_data(mesh->edgedx);
+  deallocate_data(mesh->edgedy);
+  initialise_mesh_2d(mesh);
+  handle_boundary_2d(mesh->local_nx, mesh->local_ny, mesh, *density,
+                     NO_INVERT, PACK);
+
+  move_particles(rank, nranks, px, py, cutx, cuty, owner,
+                 2 * neutral_data->nparticles, &neutral_data->nlocal_particles,
+                 neutral_data->local_particles);
+
+  if (rank == MASTER) {
+    printf("Imbalance  %.3f before, %.3f predicted after rebalance in "
+           "%.4fs\n",
+           imbalance, predicted_peak_cost * nranks / total_cost,
+           omp_get_wtime() - balance_start);
+  }
+
+  free(before);
+  free(after);
+  free(costs);
+  free(cost_x);
+  free(cost_y);
+  free(owner);
+  free(cutx);
+  free(cuty);
+#endif
+}
+
+#ifdef MPI
+// Places the cuts between nparts partitions of n cells, such that each
+// partition has a similar cost and is at least min_width cells wide
+static void partition_axis(const int n, const int nparts, const int min_width,
+                           const double* cost, int* cuts) {
+
+  double total_cost = 0.0;
+  for (int ii = 0; ii < n; ++ii) {
+    total_cost += cost[ii];
+  }
+
+  cuts[0] = 0;
+  cuts[nparts] = n;
+
+  int ii = 0;
+  double cumulative_cost = 0.0;
+  for (int pp = 1; pp < nparts; ++pp) {
+    const double target = total_cost * pp / nparts;
+
+    // Walk to the cell whose edge is closest to the target cost
+    while (ii < n && cumulative_cost + 0.5 * cost[ii] < target) {
+      cumulative_cost += cost[ii++];
+    }
+
+    // Leave room for the partitions either side of the cut
+    int cut = max(ii, cuts[pp - 1] + min_width);
+    cut = min(cut, n - (nparts - pp) * min_width);
+    while (ii < cut) {
+      cumulative_cost += cost[ii++];
+    }
+    cuts[pp] = cut;
+  }
+}
+
+// Estimates the cost of a partition from the costs measured by every rank,
+// assuming that each rank's cost was spread evenly over its cells
+static double estimate_cost(const int nranks, const Partition* before,
+                            const double* costs, const Partition* partition) {
+
+  double cost = 0.0;
+  for (int rr = 0; rr < nranks; ++rr) {
+    Partition common;
+    cost += costs[rr] * overlap(&before[rr], partition, &common) /
+            ((double)before[rr].nx * before[rr].ny);
+  }
+  return cost;
+}
+
+// Determines the cells that two partitions have in common
+static int overlap(const Partition* a, const Partition* b, Partition* common) {
+  common->x_off = max(a->x_off, b->x_off);
+  common->y_off = max(a->y_off, b->y_off);
+  common->nx = min(a->x_off + a->nx, b->x_off + b->nx) - common->x_off;
+  common->ny = min(a->y_off + a->ny, b->y_off + b->ny) - common->y_off;
+  return (common->nx > 0 && common->ny > 0) ? common->nx * common->ny : 0;
+}
+
+// Moves the cells of a field from the old to the new partitions, where the
+// field is reallocated to fit the new partition of the rank
+static void move_cells(const int rank, const int nranks, const int pad,
+                       const Partition* before, const Partition* after,
+                       double** field) {
+
+  const Partition* from = &before[rank];
+  const Partition* to = &after[rank];
+
+  int* send_counts = (int*)calloc(nranks, sizeof(int));
+  int* send_displs = (int*)calloc(nranks, sizeof(int));
+  int* recv_counts = (int*)calloc(nranks, sizeof(int));
+  int* recv_displs = (int*)calloc(nranks, sizeof(int));
+  double* send_buffer = (double*)calloc(from->nx * from->ny, sizeof(double));
+  double* recv_buffer = (double*)calloc(to->nx * to->ny, sizeof(double));
+  if (!send_counts || !send_displs || !recv_counts || !recv_displs ||
+      !send_buffer || !recv_buffer) {
+    TERMINATE("Could not allocate the cell migration buffers.\n");
+  }
+
+  // Pack the cells each rank gains from this rank in global row major order
+  int send_off = 0;
+  int recv_off = 0;
+  for (int rr = 0; rr < nranks; ++rr) {
+    Partition common;
+    send_displs[rr] = send_off;
+    send_counts[rr] = overlap(from, &after[rr], &common);
+    for (int jj = 0; jj < common.ny && send_counts[rr]; ++jj) {
+      for (int ii = 0; ii < common.nx; ++ii) {
+        const int index =
+            (common.y_off - from->y_off + jj + pad) * (from->nx + 2 * pad) +
+            (common.x_off - from->x_off + ii + pad);
+        send_buffer[send_off++] = (*field)[index];
+      }
+    }
+    recv_displs[rr] = recv_off;
+    recv_counts[rr] = overlap(&before[rr], to, &common);
+    recv_off += recv_counts[rr];
+  }
+
+  MPI_Alltoallv(send_buffer, send_counts, send_displs, MPI_DOUBLE,
+                recv_buffer, recv_counts, recv_displs, MPI_DOUBLE,
+                MPI_COMM_WORLD);
+
+  double* moved;
+  allocate_data(&moved, (to->nx + 2 * pad) * (to->ny + 2 * pad));
+
+  recv_off = 0;
+  for (int rr = 0; rr < nranks; ++rr) {
+    Partition common;
+    if (!overlap(&before[rr], to, &common)) {
+      continue;
+    }
+    for (int jj = 0; jj < common.ny; ++jj) {
+      for (int ii = 0; ii < common.nx; ++ii) {
+        const int index =
+            (common.y_off - to->y_off + jj + pad) * (to->nx + 2 * pad) +
+            (common.x_off - to->x_off + ii + pad);
+        moved[index] = recv_buffer[recv_off++];
+      }
+    }
+  }
+
+  deallocate_data(*field);
+  *field = moved;
+
+  free(send_counts);
+  free(send_displs);
+  free(recv_counts);
+  free(recv_displs);
+  free(send_buffer);
+  free(recv_buffer);
+}
+
+// Sends every particle to the rank whose new partition contains its cell
+static void move_particles(const int rank, const int nranks, const int px,
+                           const int py, const int* cutx, const int* cuty,
+                           const int* owner, const int capacity,
+                           int* nparticles, Particle* particles) {
+
+#ifdef SoA
+  TERMINATE("Load balancing requires the particles to be stored as AoS.\n");
+#else
+  int* destination = (int*)malloc(sizeof(int) * max(*nparticles, 1));
+  int* send_counts = (int*)calloc(nranks, sizeof(int));
+  int* send_displs = (int*)malloc(sizeof(int) * nranks);
+  int* recv_counts = (int*)malloc(sizeof(int) * nranks);
+  int* recv_displs = (int*)malloc(sizeof(int) * nranks);
+  if (!destination || !send_counts || !send_displs || !recv_counts ||
+      !recv_displs) {
+    TERMINATE("Could not allocate the particle migration buffers.\n");
+  }
+
+  // Find the new owner of each particle, dropping the dead particles
+  int nsend = 0;
+  for (int pp = 0; pp < *nparticles; ++pp) {
+    const Particle* particle = &particles[pp];
+    destination[pp] = -1;
+    if (particle->dead) {
+      continue;
+    }
+    int col = 0;
+    int row = 0;
+    while (col < px - 1 && particle->cellx >= cutx[col + 1]) {
+      col++;
+    }
+    while (row < py - 1 && particle->celly >= cuty[row + 1]) {
+      row++;
+    }
+    destination[pp] = owner[row * px + col];
+    if (destination[pp] != rank) {
+      send_counts[destination[pp]]++;
+      nsend++;
+    }
+  }
+
+  Particle* send_buffer = (Particle*)malloc(sizeof(Particle) * max(nsend, 1));
+  if (!send_buffer) {
+    TERMINATE("Could not allocate the particle migration buffers.\n");
+  }
+
+  int off = 0;
+  for (int rr = 0; rr < nranks; ++rr) {
+    send_displs[rr] = off;
+    off += send_counts[rr];
+  }
+
+  // Pack the departing particles and close up the particles that stay
+  int nkept = 0;
+  for (int pp = 0; pp < *nparticles; ++pp) {
+    if (destination[pp] == rank) {
+      particles[nkept++] = particles[pp];
+    } else if (destination[pp] != -1) {
+      send_buffer[send_displs[destination[pp]]++] = particles[pp];
+    }
+  }
+
+  MPI_Alltoall(send_counts, 1, MPI_INT, recv_counts, 1, MPI_INT,
+               MPI_COMM_WORLD);
+
+  // The counts and offsets are exchanged as bytes
+  int nrecv = 0;
+  for (int rr = 0; rr < nranks; ++rr) {
+    recv_displs[rr] = nrecv * sizeof(Particle);
+    nrecv += recv_counts[rr];
+    recv_counts[rr] *= sizeof(Particle);
+    send_displs[rr] = (send_displs[rr] - send_counts[rr]) * sizeof(Particle);
+    send_counts[rr] *= sizeof(Particle);
+  }
+  if (nkept + nrecv > capacity) {
+    TERMINATE("The particle bank cannot hold the rebalanced particles.\n");
+  }
+
+  MPI_Alltoallv(send_buffer, send_counts, send_displs, MPI_BYTE,
+                &particles[nkept], recv_counts, recv_displs, MPI_BYTE,
+                MPI_COMM_WORLD);
+
+  *nparticles = nkept + nrecv;
+
+  free(destination);
+  free(send_counts);
+  free(send_displs);
+  free(recv_counts);
+  free(recv_displs);
+  free(send_buffer);
+#endif
+}
+#endif
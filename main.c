@@ -62,6 +62,14 @@ int main(int argc, char** argv) {
   initialise_mpi(argc, argv, &mesh.rank, &mesh.nranks);
   initialise_devices(mesh.rank);
   initialise_comms(&mesh);
+
+  // Ranks replicating the domain split the particles rather than the mesh
+  neutral_data.options.replicated_domain = get_int_parameter(
+      "replicated_domain", neutral_data.neutral_params_filename);
+  if (neutral_data.options.replicated_domain) {
+    replicate_domain(&mesh);
+  }
+
   initialise_mesh_2d(&mesh);
   SharedData shared_data = {0};
   initialise_shared_data_2d(mesh.local_nx, mesh.local_ny, mesh.pad, mesh.width, 
@@ -89,7 +97,8 @@ int main(int argc, char** argv) {
     }
 
     if (visit_dump) {
-      plot_particle_density(&neutral_data, &mesh, tt, neutral_data.nparticles,
+      plot_particle_density(&neutral_data, &mesh, tt,
+                            neutral_data.nlocal_particles,
                             elapsed_sim_time);
     }
 
@@ -105,9 +114,18 @@ int main(int argc, char** argv) {
         mesh.neighbours, neutral_data.local_particles,
         shared_data.density, mesh.edgex, mesh.edgey, mesh.edgedx, mesh.edgedy,
         neutral_data.cs_scatter_table, neutral_data.cs_absorb_table,
-        neutral_data.energy_deposition_tally, neutral_data.nfacets_reduce_array,
+        neutral_data.cs_unionized_table, neutral_data.energy_deposition_tally,
+        neutral_data.scalar_flux_tally,
+        neutral_data.nfacets_reduce_array,
         neutral_data.ncollisions_reduce_array, neutral_data.nprocessed_reduce_array,
-        &facet_events, &collision_events);
+        &facet_events, &collision_events, &neutral_data.options);
+
+    if (neutral_data.options.replicated_domain &&
+        neutral_data.options.tally_reduction != RUN_REDUCTION) {
+      reduce_replicated_tallies(
+          &neutral_data, &mesh,
+          neutral_data.options.tally_reduction == NONBLOCKING_REDUCTION);
+    }
 
     barrier();
     
@@ -127,15 +145,41 @@ int main(int argc, char** argv) {
     elapsed_sim_time += mesh.dt;
 
     if (visit_dump) {
+      // A coarse tally mesh is held whole by every rank
+      const int coarse_tally = (neutral_data.options.tally_nx > 0);
+      const int tally_global_nx =
+          coarse_tally ? neutral_data.tally_nx : mesh.global_nx;
+      const int tally_global_ny =
+          coarse_tally ? neutral_data.tally_ny : mesh.global_ny;
+      const int tally_x_off = coarse_tally ? 0 : mesh.x_off;
+      const int tally_y_off = coarse_tally ? 0 : mesh.y_off;
+
       char tally_name[100];
       sprintf(tally_name, "energy%d", tt);
       int dneighbours[NNEIGHBOURS] = {EDGE, EDGE, EDGE, EDGE, EDGE, EDGE};
       write_all_ranks_to_visit(
-          mesh.global_nx, mesh.global_ny, mesh.local_nx - 2 * mesh.pad,
-          mesh.local_ny - 2 * mesh.pad, mesh.pad, mesh.x_off, mesh.y_off,
+          tally_global_nx, tally_global_ny, neutral_data.tally_nx,
+          neutral_data.tally_ny, mesh.pad, tally_x_off, tally_y_off,
           mesh.rank, mesh.nranks, dneighbours,
           neutral_data.energy_deposition_tally, tally_name, 0,
           elapsed_sim_time);
+
+      if (neutral_data.scalar_flux_tally) {
+        sprintf(tally_name, "flux%d", tt);
+        write_all_ranks_to_visit(
+            tally_global_nx, tally_global_ny, neutral_data.tally_nx,
+            neutral_data.tally_ny, mesh.pad, tally_x_off, tally_y_off,
+            mesh.rank, mesh.nranks, dneighbours, neutral_data.scalar_flux_tally,
+            tally_name, 0, elapsed_sim_time);
+      }
+    }
+
+    // Rebalance the ranks by the events each tracked this timestep
+    if (neutral_data.options.load_balance &&
+        !neutral_data.options.replicated_domain && tt < mesh.niters &&
+        tt % neutral_data.options.load_balance == 0) {
+      balance_load(&neutral_data, &mesh, &shared_data.density,
+                   facet_events + collision_events);
     }
 
     // Leave the simulation if we have reached the simulation end time
@@ -146,12 +190,22 @@ int main(int argc, char** argv) {
     }
   }
 
+  // The master rank holds the whole tally once the reductions complete
+  if (neutral_data.options.replicated_domain) {
+    if (neutral_data.options.tally_reduction == RUN_REDUCTION) {
+      reduce_replicated_tallies(&neutral_data, &mesh, 0);
+    } else {
+      complete_replicated_tallies(&neutral_data);
+    }
+  }
+
   if (visit_dump) {
-    plot_particle_density(&neutral_data, &mesh, tt, neutral_data.nparticles,
+    plot_particle_density(&neutral_data, &mesh, tt,
+                          neutral_data.nlocal_particles,
                           elapsed_sim_time);
   }
 
-  validate(mesh.local_nx - 2 * mesh.pad, mesh.local_ny - 2 * mesh.pad,
+  validate(neutral_data.tally_nx, neutral_data.tally_ny,
            neutral_data.neutral_params_filename, mesh.rank,
            neutral_data.energy_deposition_tally);
 
@@ -175,7 +229,19 @@ void plot_particle_density(NeutralData* neutral_data, Mesh* mesh, const int tt,
     TERMINATE("Could not allocate data for printing.\n");
   }
 
-  for (int ii = 0; ii < nparticles; ++ii) {
+  // The bank may be held outside of the AoS array of particles, and only
+  // holds the rank's own particles
+  ParticleBank* bank = neutral_data->options.bank;
+  const int nplotted = (bank) ? min(nparticles, bank->nparticles) : nparticles;
+  for (int ii = 0; ii < nplotted; ++ii) {
+    if (bank) {
+      Particle particle;
+      load_particle(bank, ii, mesh->pad, mesh->x_off, mesh->y_off,
+                    mesh->edgex, mesh->edgey, &particle);
+      temp[(particle.celly - mesh->y_off) * (mesh->local_nx - 2 * mesh->pad) +
+           (particle.cellx - mesh->x_off)] += 1.0;
+      continue;
+    }
     Particle* particle = &neutral_data->local_particles[ii];
 #ifdef SoA
     const int cellx = particle->cellx[ii] - mesh->x_off;
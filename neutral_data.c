@@ -6,15 +6,46 @@
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #define max(a, b) (((a) > (b)) ? (a) : (b))
 
 // Reads a cross section file
-void read_cs_file(const char* filename, CrossSection* cs, Mesh* mesh);
+void read_cs_file(const char* filename, const int nbins, CrossSection* cs,
+                  Mesh* mesh);
+
+// Builds the log-energy hash grid over the keys of a cross section table
+void build_cs_hash_grid(const int nbins, const double* keys, CrossSection* cs);
+
+// Builds a unionized energy grid holding the values of every table at the
+// union of their keys
+void build_unionized_grid(const int ntables, CrossSection** tables,
+                          const int nbins, CrossSection* unionized,
+                          Mesh* mesh);
+
+// Orders energies for sorting the unionized keys
+static int compare_energies(const void* a, const void* b);
 
 // Initialises the set of cross sections
 void initialise_cross_sections(NeutralData* neutral_data, Mesh* mesh);
 
+// Calculates the resolution of the reproducible energy deposition tally
+double calculate_tally_unit(NeutralData* neutral_data, Mesh* mesh);
+
+// Calculates the resolution of the reproducible scalar flux tally
+double calculate_flux_unit(NeutralData* neutral_data, Mesh* mesh);
+
+// Finds the largest density of the problem regions in the parameter file
+double max_problem_density(const char* params_filename);
+
+// Reads the rectangles of the problem regions in the parameter file
+ProblemRegion* read_problem_regions(const char* params_filename, Mesh* mesh,
+                                    int* nregions);
+
+// Copies the particle bank out of the AoS array into the layout selected at
+// runtime, returning the allocated bytes
+size_t initialise_particle_bank(NeutralData* neutral_data, Mesh* mesh);
+
 // Initialises all of the neutral-specific data structures.
 void initialise_neutral_data(NeutralData* neutral_data, Mesh* mesh) {
   const int pad = mesh->pad;
@@ -25,6 +56,72 @@ void initialise_neutral_data(NeutralData* neutral_data, Mesh* mesh) {
       get_int_parameter("nparticles", neutral_data->neutral_params_filename);
   neutral_data->initial_energy = get_double_parameter(
       "initial_energy", neutral_data->neutral_params_filename);
+  neutral_data->options.transport_mode = get_int_parameter(
+      "transport_mode", neutral_data->neutral_params_filename);
+  neutral_data->options.hybrid_threshold = get_int_parameter(
+      "hybrid_threshold", neutral_data->neutral_params_filename);
+  neutral_data->options.scheduler = get_int_parameter(
+      "scheduler", neutral_data->neutral_params_filename);
+  neutral_data->options.particle_sort = get_int_parameter(
+      "particle_sort", neutral_data->neutral_params_filename);
+  neutral_data->options.tile_size = get_int_parameter(
+      "tile_size", neutral_data->neutral_params_filename);
+  if (neutral_data->options.transport_mode == TILED_BASED &&
+      neutral_data->options.tile_size <= 0) {
+    TERMINATE("Tiled transport requires a positive tile size.\n");
+  }
+  neutral_data->options.tally_mode = get_int_parameter(
+      "tally_mode", neutral_data->neutral_params_filename);
+  neutral_data->options.flux_tally = get_int_parameter(
+      "flux_tally", neutral_data->neutral_params_filename);
+  neutral_data->options.load_balance = get_int_parameter(
+      "load_balance", neutral_data->neutral_params_filename);
+  neutral_data->options.tally_reduction = get_int_parameter(
+      "tally_reduction", neutral_data->neutral_params_filename);
+  neutral_data->options.cs_hash_bins = get_int_parameter(
+      "cs_hash_bins", neutral_data->neutral_params_filename);
+  neutral_data->options.cs_benchmark = get_int_parameter(
+      "cs_benchmark", neutral_data->neutral_params_filename);
+  neutral_data->options.cs_unionized = get_int_parameter(
+      "cs_unionized", neutral_data->neutral_params_filename);
+  neutral_data->options.macro_cells = get_int_parameter(
+      "macro_cells", neutral_data->neutral_params_filename);
+  neutral_data->options.csg_geometry = get_int_parameter(
+      "csg_geometry", neutral_data->neutral_params_filename);
+  neutral_data->options.tally_nx = get_int_parameter(
+      "tally_nx", neutral_data->neutral_params_filename);
+  neutral_data->options.tally_ny = get_int_parameter(
+      "tally_ny", neutral_data->neutral_params_filename);
+  neutral_data->options.compact_layout = get_int_parameter(
+      "compact_layout", neutral_data->neutral_params_filename);
+  neutral_data->options.particle_layout = get_int_parameter(
+      "particle_layout", neutral_data->neutral_params_filename);
+  neutral_data->options.simd_kernels = get_int_parameter(
+      "simd_kernels", neutral_data->neutral_params_filename);
+  neutral_data->options.particle_key_offset = 0;
+  neutral_data->options.tally_unit = 0.0;
+  neutral_data->options.flux_unit = 0.0;
+  neutral_data->options.history_event_cost = 0.0;
+  neutral_data->options.majorant_density = 0.0;
+  neutral_data->options.unionized_table = NULL;
+  neutral_data->options.cell_material = NULL;
+  neutral_data->options.material_density = NULL;
+  neutral_data->options.material_number_density = NULL;
+  neutral_data->options.macro_cell_level = NULL;
+  neutral_data->options.tally_cell_x = NULL;
+  neutral_data->options.tally_cell_y = NULL;
+  neutral_data->options.simd_lanes = 0;
+  neutral_data->options.problem_regions = NULL;
+  neutral_data->options.nproblem_regions = 0;
+  neutral_data->options.bank = NULL;
+  if (neutral_data->options.csg_geometry) {
+    if (neutral_data->options.transport_mode != HISTORY_BASED) {
+      TERMINATE("CSG geometry requires history-based tracking.\n");
+    }
+    neutral_data->options.problem_regions = read_problem_regions(
+        neutral_data->neutral_params_filename, mesh,
+        &neutral_data->options.nproblem_regions);
+  }
 
   int nkeys = 0;
   char* keys = (char*)malloc(sizeof(char) * MAX_KEYS * MAX_STR_LEN);
@@ -42,10 +139,11 @@ void initialise_neutral_data(NeutralData* neutral_data, Mesh* mesh) {
   const double source_width = values[nkeys - 2] * mesh->width;
   const double source_height = values[nkeys - 1] * mesh->height;
 
-  double* mesh_edgex_0 = &mesh->edgex[mesh->x_off + pad];
-  double* mesh_edgey_0 = &mesh->edgey[mesh->y_off + pad];
-  double* mesh_edgex_1 = &mesh->edgex[local_nx + mesh->x_off + pad];
-  double* mesh_edgey_1 = &mesh->edgey[local_ny + mesh->y_off + pad];
+  // The edges are stored for the local cells only
+  double* mesh_edgex_0 = &mesh->edgex[pad];
+  double* mesh_edgey_0 = &mesh->edgey[pad];
+  double* mesh_edgex_1 = &mesh->edgex[local_nx + pad];
+  double* mesh_edgey_1 = &mesh->edgey[local_ny + pad];
 
   double* rank_xpos_0;
   double* rank_ypos_0;
@@ -94,8 +192,33 @@ void initialise_neutral_data(NeutralData* neutral_data, Mesh* mesh) {
   // Rounding hack to make sure correct number of particles is selected
   neutral_data->nlocal_particles = nlocal_particles_real + 0.5;
 
-  size_t allocation = allocate_data(&neutral_data->energy_deposition_tally,
-                                    local_nx * local_ny);
+  // A coarse tally mesh covers the whole problem on every rank, as its cells
+  // would otherwise be split between the ranks sharing them
+  neutral_data->tally_nx = local_nx;
+  neutral_data->tally_ny = local_ny;
+  if (neutral_data->options.tally_nx) {
+    if (neutral_data->options.tally_nx > mesh->global_nx ||
+        neutral_data->options.tally_ny > mesh->global_ny ||
+        neutral_data->options.tally_ny <= 0) {
+      TERMINATE("The tally mesh must be no finer than the transport mesh.\n");
+    }
+    if (mesh->nranks > 1 && !neutral_data->options.replicated_domain) {
+      TERMINATE("A coarse tally mesh requires a replicated domain.\n");
+    }
+    neutral_data->tally_nx = neutral_data->options.tally_nx;
+    neutral_data->tally_ny = neutral_data->options.tally_ny;
+  }
+  const int tally_ncells = neutral_data->tally_nx * neutral_data->tally_ny;
+
+  size_t allocation =
+      allocate_data(&neutral_data->energy_deposition_tally, tally_ncells);
+
+  // The flux tally is left unallocated when off, which skips its accumulation
+  neutral_data->scalar_flux_tally = NULL;
+  if (neutral_data->options.flux_tally) {
+    allocation +=
+        allocate_data(&neutral_data->scalar_flux_tally, tally_ncells);
+  }
 
   allocation += allocate_uint64_data(&neutral_data->nfacets_reduce_array,
                                      neutral_data->nparticles);
@@ -104,23 +227,63 @@ void initialise_neutral_data(NeutralData* neutral_data, Mesh* mesh) {
   allocation += allocate_uint64_data(&neutral_data->nprocessed_reduce_array,
                                      neutral_data->nparticles);
 
-  // Inject some particles into the mesh if we need to
-  if (neutral_data->nlocal_particles) {
-    allocation += inject_particles(
-        neutral_data->nparticles, mesh->global_nx, mesh->local_nx,
-        mesh->local_ny, pad, local_particle_left_off, local_particle_bottom_off,
-        local_particle_width, local_particle_height, mesh->x_off, mesh->y_off,
-        mesh->dt, mesh->edgex, mesh->edgey, neutral_data->initial_energy,
-        &neutral_data->local_particles);
+  // Inject some particles into the mesh, every rank needs a bank as
+  // particles migrate in from the neighbouring ranks. The shaded bounds are
+  // relative to the rank, so are moved to the rank's origin.
+  allocation += inject_particles(
+      neutral_data->nparticles, mesh->global_nx, mesh->local_nx,
+      mesh->local_ny, pad, *rank_xpos_0 + local_particle_left_off,
+      *rank_ypos_0 + local_particle_bottom_off, local_particle_width,
+      local_particle_height, mesh->x_off, mesh->y_off, mesh->dt, mesh->edgex,
+      mesh->edgey, neutral_data->initial_energy,
+      &neutral_data->local_particles);
+
+  // Ranks replicating the domain each track a contiguous slice of the
+  // particles, keyed by their global identifiers as in a single rank run
+  if (neutral_data->options.replicated_domain) {
+#ifdef SoA
+    TERMINATE("Replicated domains require particles stored as AoS.\n");
+#else
+    const int share = neutral_data->nparticles / mesh->nranks;
+    const int remainder = neutral_data->nparticles % mesh->nranks;
+    const int first = mesh->rank * share + min(mesh->rank, remainder);
+    neutral_data->nlocal_particles = share + (mesh->rank < remainder);
+    memmove(neutral_data->local_particles,
+            &neutral_data->local_particles[first],
+            sizeof(Particle) * neutral_data->nlocal_particles);
+    neutral_data->options.particle_key_offset = first;
+#endif
+  }
+
+  if (neutral_data->options.compact_layout != FULL_LAYOUT ||
+      neutral_data->options.particle_layout != AOS_LAYOUT) {
+    allocation += initialise_particle_bank(neutral_data, mesh);
+
+    // The full-precision bank is only kept to validate the compact layout
+    if (neutral_data->options.compact_layout != VALIDATED_COMPACT_LAYOUT) {
+      free(neutral_data->local_particles);
+      neutral_data->local_particles = NULL;
+      allocation -= sizeof(Particle) * neutral_data->nparticles * 2;
+    }
   }
 
   printf("Allocated %.4fGB of data.\n", allocation / GB);
 
   initialise_cross_sections(neutral_data, mesh);
+
+  if (neutral_data->options.tally_mode == REPRODUCIBLE_TALLY) {
+    neutral_data->options.tally_unit = calculate_tally_unit(neutral_data, mesh);
+    neutral_data->options.flux_unit = calculate_flux_unit(neutral_data, mesh);
+    if (mesh->rank == MASTER) {
+      printf("Reproducible tally resolution %.6e\n",
+             neutral_data->options.tally_unit);
+    }
+  }
 }
 
 // Reads in a cross-sectional data file
-void read_cs_file(const char* filename, CrossSection* cs, Mesh* mesh) {
+void read_cs_file(const char* filename, const int nbins, CrossSection* cs,
+                  Mesh* mesh) {
   FILE* fp = fopen(filename, "r");
   if (!fp) {
     TERMINATE("Could not open the cross section file: %s\n", filename);
@@ -165,6 +328,9 @@ void read_cs_file(const char* filename, CrossSection* cs, Mesh* mesh) {
     fscanf(fp, "%lf", &h_values[ii]);
   }
 
+  cs->nreactions = 1;
+  build_cs_hash_grid(nbins, h_keys, cs);
+
   move_host_buffer_to_device(cs->nentries, &h_keys, &cs->keys);
   move_host_buffer_to_device(cs->nentries, &h_values, &cs->values);
 }
@@ -173,6 +339,449 @@ void read_cs_file(const char* filename, CrossSection* cs, Mesh* mesh) {
 void initialise_cross_sections(NeutralData* neutral_data, Mesh* mesh) {
   neutral_data->cs_scatter_table = (CrossSection*)malloc(sizeof(CrossSection));
   neutral_data->cs_absorb_table = (CrossSection*)malloc(sizeof(CrossSection));
-  read_cs_file(CS_SCATTER_FILENAME, neutral_data->cs_scatter_table, mesh);
-  read_cs_file(CS_CAPTURE_FILENAME, neutral_data->cs_absorb_table, mesh);
+  read_cs_file(CS_SCATTER_FILENAME, neutral_data->options.cs_hash_bins,
+               neutral_data->cs_scatter_table, mesh);
+  read_cs_file(CS_CAPTURE_FILENAME, neutral_data->options.cs_hash_bins,
+               neutral_data->cs_absorb_table, mesh);
+
+  neutral_data->cs_unionized_table = NULL;
+  if (neutral_data->options.cs_unionized) {
+    // The tables are listed in the order of the reactions
+    CrossSection* tables[NREACTIONS];
+    tables[SCATTER_REACTION] = neutral_data->cs_scatter_table;
+    tables[ABSORB_REACTION] = neutral_data->cs_absorb_table;
+    neutral_data->cs_unionized_table =
+        (CrossSection*)malloc(sizeof(CrossSection));
+    build_unionized_grid(NREACTIONS, tables,
+                         neutral_data->options.cs_hash_bins,
+                         neutral_data->cs_unionized_table, mesh);
+  }
+}
+
+// Builds a unionized energy grid holding the values of every table at the
+// union of their keys.
+//
+// Each table is interpolated at the keys of the others, so the values at a
+// table's own keys are exact and a lookup within the grid interpolates every
+// reaction from the same interval.
+void build_unionized_grid(const int ntables, CrossSection** tables,
+                          const int nbins, CrossSection* unionized,
+                          Mesh* mesh) {
+
+  int nkeys = 0;
+  for (int tt = 0; tt < ntables; ++tt) {
+    nkeys += tables[tt]->nentries;
+  }
+
+  double* h_keys;
+  allocate_host_data(&h_keys, nkeys);
+  int kk = 0;
+  for (int tt = 0; tt < ntables; ++tt) {
+    for (int ii = 0; ii < tables[tt]->nentries; ++ii) {
+      h_keys[kk++] = tables[tt]->keys[ii];
+    }
+  }
+
+  // The keys shared by several tables are only kept once
+  qsort(h_keys, nkeys, sizeof(double), compare_energies);
+  unionized->nentries = 0;
+  for (int ii = 0; ii < nkeys; ++ii) {
+    if (!unionized->nentries || h_keys[ii] != h_keys[unionized->nentries - 1]) {
+      h_keys[unionized->nentries++] = h_keys[ii];
+    }
+  }
+  unionized->nreactions = ntables;
+
+  double* h_values;
+  allocate_host_data(&h_values, unionized->nentries * ntables);
+  for (int tt = 0; tt < ntables; ++tt) {
+    const CrossSection* table = tables[tt];
+
+    // Both sets of keys are sorted, so the interval of each table only moves
+    // forward, and the table's end values hold beyond its range
+    int ind = 0;
+    for (int ii = 0; ii < unionized->nentries; ++ii) {
+      const double energy = h_keys[ii];
+      while (ind < table->nentries - 2 && energy >= table->keys[ind + 1]) {
+        ind++;
+      }
+
+      double value;
+      if (energy <= table->keys[0]) {
+        value = table->values[0];
+      } else if (energy >= table->keys[table->nentries - 1]) {
+        value = table->values[table->nentries - 1];
+      } else {
+        value = table->values[ind] +
+                ((energy - table->keys[ind]) /
+                 (table->keys[ind + 1] - table->keys[ind])) *
+                    (table->values[ind + 1] - table->values[ind]);
+      }
+      h_values[ii * ntables + tt] = value;
+    }
+  }
+
+  if (mesh->rank == MASTER) {
+    printf("Unionized grid of %d tables contains %d entries\n", ntables,
+           unionized->nentries);
+  }
+
+  build_cs_hash_grid(nbins, h_keys, unionized);
+
+  move_host_buffer_to_device(unionized->nentries, &h_keys, &unionized->keys);
+  move_host_buffer_to_device(unionized->nentries * ntables, &h_values,
+                             &unionized->values);
+}
+
+// Orders energies for sorting the unionized keys
+static int compare_energies(const void* a, const void* b) {
+  const double energy_a = *(const double*)a;
+  const double energy_b = *(const double*)b;
+  return (energy_a > energy_b) - (energy_a < energy_b);
+}
+
+// Builds the log-energy hash grid over the keys of a cross section table.
+//
+// Each bin stores the entry whose interval holds the bin's lower bound, so an
+// energy falling in bin b lies in one of the intervals bin_entries[b] to
+// bin_entries[b + 1], which the lookup then searches.
+void build_cs_hash_grid(const int nbins, const double* keys, CrossSection* cs) {
+  cs->nbins = 0;
+  cs->bin_entries = NULL;
+  if (nbins <= 0 || cs->nentries < 2 || keys[0] <= 0.0) {
+    return;
+  }
+
+  cs->nbins = nbins;
+  cs->log_key_min = log(keys[0]);
+  cs->inv_bin_width = nbins / (log(keys[cs->nentries - 1]) - cs->log_key_min);
+  allocate_host_int_data(&cs->bin_entries, nbins + 1);
+
+  // The bounds only increase, so a single sweep over the keys finds them all
+  int entry = 0;
+  for (int bb = 0; bb < nbins; ++bb) {
+    const double lower = exp(cs->log_key_min + bb / cs->inv_bin_width);
+    while (entry < cs->nentries - 2 && keys[entry + 1] <= lower) {
+      entry++;
+    }
+    cs->bin_entries[bb] = entry;
+  }
+  cs->bin_entries[nbins] = cs->nentries - 2;
+}
+
+// Calculates the resolution of the reproducible energy deposition tally.
+//
+// Energy only decreases, so a particle deposits at most initial_energy per
+// mean free path, and travels at most speed * dt in a timestep. This bounds
+// the deposition of every cell, and of the whole mesh, over the run. Rounding
+// every contribution to a power of two chosen so the bound is 2^51 units
+// makes every partial sum exact in double precision, so the tally is
+// independent of the order of the adds, the thread count and the rank count.
+double calculate_tally_unit(NeutralData* neutral_data, Mesh* mesh) {
+  double max_cs_scatter = 0.0;
+  for (int ii = 0; ii < neutral_data->cs_scatter_table->nentries; ++ii) {
+    max_cs_scatter =
+        max(max_cs_scatter, neutral_data->cs_scatter_table->values[ii]);
+  }
+  double max_cs_absorb = 0.0;
+  for (int ii = 0; ii < neutral_data->cs_absorb_table->nentries; ++ii) {
+    max_cs_absorb =
+        max(max_cs_absorb, neutral_data->cs_absorb_table->values[ii]);
+  }
+
+  const double max_macroscopic_cs =
+      max_problem_density(neutral_data->neutral_params_filename) * AVOGADROS /
+      MOLAR_MASS * (max_cs_scatter + max_cs_absorb) * BARNS;
+  const double max_speed =
+      sqrt((2.0 * neutral_data->initial_energy * eV_TO_J) / PARTICLE_MASS);
+  const double max_deposition = mesh->niters * neutral_data->initial_energy *
+                                max_macroscopic_cs * max_speed * mesh->dt;
+
+  if (max_deposition <= 0.0) {
+    return 1.0;
+  }
+
+  // Headroom of a factor of two absorbs the rounding of each contribution
+  return ldexp(1.0, ilogb(max_deposition) + 1 - 51);
+}
+
+// Calculates the resolution of the reproducible scalar flux tally.
+//
+// Weights never exceed one, so a particle contributes at most speed * dt of
+// track length in a timestep, which bounds the flux in the same way.
+double calculate_flux_unit(NeutralData* neutral_data, Mesh* mesh) {
+  const double max_speed =
+      sqrt((2.0 * neutral_data->initial_energy * eV_TO_J) / PARTICLE_MASS);
+  const double max_flux = mesh->niters * max_speed * mesh->dt;
+
+  if (max_flux <= 0.0) {
+    return 1.0;
+  }
+
+  return ldexp(1.0, ilogb(max_flux) + 1 - 51);
+}
+
+// Finds the largest density of the problem regions in the parameter file
+double max_problem_density(const char* params_filename) {
+  char* keys = (char*)malloc(sizeof(char) * MAX_KEYS * MAX_STR_LEN);
+  double* values = (double*)malloc(sizeof(double) * MAX_KEYS);
+
+  double max_density = 0.0;
+  for (int pp = 0;; ++pp) {
+    char specifier[MAX_STR_LEN];
+    sprintf(specifier, "problem_%d", pp);
+
+    int nkeys = 0;
+    if (!get_key_value_parameter(specifier, params_filename, keys, values,
+                                 &nkeys)) {
+      break;
+    }
+
+    for (int kk = 0; kk < nkeys; ++kk) {
+      if (strcmp(&keys[kk * MAX_STR_LEN], "density") == 0) {
+        max_density = max(max_density, values[kk]);
+      }
+    }
+  }
+
+  free(keys);
+  free(values);
+  return max_density;
+}
+
+// Reads the rectangles of the problem regions in the parameter file
+ProblemRegion* read_problem_regions(const char* params_filename, Mesh* mesh,
+                                    int* nregions) {
+  char* keys = (char*)malloc(sizeof(char) * MAX_KEYS * MAX_STR_LEN);
+  double* values = (double*)malloc(sizeof(double) * MAX_KEYS);
+
+  ProblemRegion* regions = NULL;
+  *nregions = 0;
+  for (int pp = 0;; ++pp) {
+    char specifier[MAX_STR_LEN];
+    sprintf(specifier, "problem_%d", pp);
+
+    int nkeys = 0;
+    if (!get_key_value_parameter(specifier, params_filename, keys, values,
+                                 &nkeys)) {
+      break;
+    }
+
+    regions =
+        (ProblemRegion*)realloc(regions, sizeof(ProblemRegion) * (pp + 1));
+    if (!regions) {
+      TERMINATE("Could not allocate the problem regions.\n");
+    }
+
+    // The last four keys are the bound specification
+    ProblemRegion* region = &regions[pp];
+    region->x0 = values[nkeys - 4] * mesh->width;
+    region->y0 = values[nkeys - 3] * mesh->height;
+    region->x1 = region->x0 + values[nkeys - 2] * mesh->width;
+    region->y1 = region->y0 + values[nkeys - 1] * mesh->height;
+    region->density = 0.0;
+    for (int kk = 0; kk < nkeys; ++kk) {
+      if (strcmp(&keys[kk * MAX_STR_LEN], "density") == 0) {
+        region->density = values[kk];
+      }
+    }
+    (*nregions)++;
+  }
+
+  free(keys);
+  free(values);
+  return regions;
+}
+
+// Copies the particle bank out of the AoS array into the layout selected at
+// runtime, returning the allocated bytes
+size_t initialise_particle_bank(NeutralData* neutral_data, Mesh* mesh) {
+#ifdef SoA
+  TERMINATE("Runtime particle layouts require particles stored as AoS.\n");
+  return 0;
+#else
+  // The bank is only loaded by the histories, so the particles can neither
+  // be exchanged between ranks nor swept by the other algorithms
+  TransportOptions* options = &neutral_data->options;
+  if ((options->transport_mode != HISTORY_BASED &&
+       options->transport_mode != DELTA_BASED) ||
+      options->scheduler != STATIC_SCHEDULER ||
+      options->particle_sort != NO_SORT) {
+    TERMINATE("Particle layouts other than AoS require history-based or delta "
+              "tracking with the static scheduler and no particle sort.\n");
+  }
+  if (mesh->nranks > 1 && !options->replicated_domain) {
+    TERMINATE("Particle layouts other than AoS require a replicated domain.\n");
+  }
+
+  // The compact layout only stores the particles as AoS
+  ParticleBank* bank = (ParticleBank*)malloc(sizeof(ParticleBank));
+  if (!bank) {
+    TERMINATE("Could not allocate the particle bank.\n");
+  }
+  bank->layout = options->particle_layout;
+  bank->nparticles = neutral_data->nlocal_particles;
+  bank->blocks = NULL;
+  bank->compact = NULL;
+  if (options->compact_layout != FULL_LAYOUT) {
+    if (bank->layout != AOS_LAYOUT) {
+      TERMINATE("The compact layout requires the AoS particle layout.\n");
+    }
+  } else if (bank->layout != SOA_LAYOUT && bank->layout != AOSOA_LAYOUT) {
+    TERMINATE("Unknown particle layout %d.\n", bank->layout);
+  }
+
+  const int nparticles = bank->nparticles;
+  const int nblocks =
+      (nparticles + PARTICLE_BLOCK_SIZE - 1) / PARTICLE_BLOCK_SIZE;
+  size_t allocation = 0;
+  if (bank->layout == AOS_LAYOUT) {
+    allocation = sizeof(CompactParticle) * nparticles;
+    bank->compact = (CompactParticle*)malloc(sizeof(CompactParticle) *
+                                             max(nparticles, 1));
+  } else if (bank->layout == SOA_LAYOUT) {
+#define ALLOCATE_ARRAY_FIELD(type, name)                                       \
+  allocation += sizeof(type) * nparticles;                                     \
+  bank->arrays.name = (type*)malloc(sizeof(type) * max(nparticles, 1));        \
+  if (!bank->arrays.name) {                                                    \
+    TERMINATE("Could not allocate the particle bank.\n");                      \
+  }
+    PARTICLE_FIELDS(ALLOCATE_ARRAY_FIELD)
+#undef ALLOCATE_ARRAY_FIELD
+  } else {
+    allocation = sizeof(ParticleBlock) * nblocks;
+    bank->blocks =
+        (ParticleBlock*)malloc(sizeof(ParticleBlock) * max(nblocks, 1));
+  }
+  if (bank->layout != SOA_LAYOUT && !bank->compact && !bank->blocks) {
+    TERMINATE("Could not allocate the particle bank.\n");
+  }
+
+  // The lanes of the last block beyond the bank hold dead particles
+  if (bank->layout == AOSOA_LAYOUT) {
+    for (int pp = nparticles; pp < nblocks * PARTICLE_BLOCK_SIZE; ++pp) {
+      bank->blocks[pp / PARTICLE_BLOCK_SIZE].dead[pp % PARTICLE_BLOCK_SIZE] = 1;
+    }
+  }
+
+#pragma omp parallel for
+  for (int pp = 0; pp < nparticles; ++pp) {
+    store_particle(bank, pp, mesh->pad, mesh->x_off, mesh->y_off, mesh->edgex,
+                   mesh->edgey, &neutral_data->local_particles[pp]);
+  }
+  options->bank = bank;
+
+  const char* layouts[] = {"compact AoS", "SoA", "AoSoA"};
+  printf("Particle bank of %d particles in the %s layout\n", nparticles,
+         layouts[bank->layout]);
+
+  return allocation;
+#endif
+}
+
+#ifndef SoA
+// Stores a particle in the compact layout, relative to its local cell
+void pack_particle(const int pad, const int x_off, const int y_off,
+                   const double* edgex, const double* edgey,
+                   const Particle* particle, CompactParticle* compact) {
+
+  // The offsets are kept strictly below one, as rounding them up would place
+  // the particle on the far facet of its cell
+  const int cellx = particle->cellx - x_off + pad;
+  const int celly = particle->celly - y_off + pad;
+  const float below_one = nextafterf(1.0f, 0.0f);
+  const float x =
+      (particle->x - edgex[cellx]) / (edgex[cellx + 1] - edgex[cellx]);
+  const float y =
+      (particle->y - edgey[celly]) / (edgey[celly + 1] - edgey[celly]);
+  compact->x = fminf(fmaxf(x, 0.0f), below_one);
+  compact->y = fminf(fmaxf(y, 0.0f), below_one);
+
+  compact->energy = particle->energy;
+  compact->weight = particle->weight;
+  compact->dt_to_census = particle->dt_to_census;
+  compact->mfp_to_collision = particle->mfp_to_collision;
+  compact->omega_x = particle->omega_x;
+  compact->omega_y = particle->omega_y;
+  compact->cellx = particle->cellx;
+  compact->celly = particle->celly;
+  compact->scatter_cs_index = particle->scatter_cs_index;
+  compact->absorb_cs_index = particle->absorb_cs_index;
+  compact->dead = (particle->dead != 0);
+}
+
+// Restores a particle stored in the compact layout to full precision
+void unpack_particle(const int pad, const int x_off, const int y_off,
+                     const double* edgex, const double* edgey,
+                     const CompactParticle* compact, Particle* particle) {
+
+  const int cellx = compact->cellx - x_off + pad;
+  const int celly = compact->celly - y_off + pad;
+  particle->x =
+      edgex[cellx] + compact->x * (edgex[cellx + 1] - edgex[cellx]);
+  particle->y =
+      edgey[celly] + compact->y * (edgey[celly + 1] - edgey[celly]);
+
+  // The rounded direction is renormalised, so that distances along the
+  // flight are still measured in units of length
+  const double omega_x = compact->omega_x;
+  const double omega_y = compact->omega_y;
+  const double inv_norm = 1.0 / sqrt(omega_x * omega_x + omega_y * omega_y);
+  particle->omega_x = omega_x * inv_norm;
+  particle->omega_y = omega_y * inv_norm;
+
+  particle->energy = compact->energy;
+  particle->weight = compact->weight;
+  particle->dt_to_census = compact->dt_to_census;
+  particle->mfp_to_collision = compact->mfp_to_collision;
+  particle->cellx = compact->cellx;
+  particle->celly = compact->celly;
+  particle->scatter_cs_index = compact->scatter_cs_index;
+  particle->absorb_cs_index = compact->absorb_cs_index;
+  particle->dead = compact->dead;
+}
+#endif
+
+#ifndef SoA
+// Loads a particle from the bank in full precision
+void load_particle(const ParticleBank* bank, const int pid, const int pad,
+                   const int x_off, const int y_off, const double* edgex,
+                   const double* edgey, Particle* particle) {
+
+  if (bank->layout == SOA_LAYOUT) {
+#define LOAD_ARRAY_FIELD(type, name) particle->name = bank->arrays.name[pid];
+    PARTICLE_FIELDS(LOAD_ARRAY_FIELD)
+#undef LOAD_ARRAY_FIELD
+  } else if (bank->layout == AOSOA_LAYOUT) {
+    const ParticleBlock* block = &bank->blocks[pid / PARTICLE_BLOCK_SIZE];
+    const int lane = pid % PARTICLE_BLOCK_SIZE;
+#define LOAD_BLOCK_FIELD(type, name) particle->name = block->name[lane];
+    PARTICLE_FIELDS(LOAD_BLOCK_FIELD)
+#undef LOAD_BLOCK_FIELD
+  } else {
+    unpack_particle(pad, x_off, y_off, edgex, edgey, &bank->compact[pid],
+                    particle);
+  }
+}
+
+// Stores a particle in the bank
+void store_particle(ParticleBank* bank, const int pid, const int pad,
+                    const int x_off, const int y_off, const double* edgex,
+                    const double* edgey, const Particle* particle) {
+
+  if (bank->layout == SOA_LAYOUT) {
+#define STORE_ARRAY_FIELD(type, name) bank->arrays.name[pid] = particle->name;
+    PARTICLE_FIELDS(STORE_ARRAY_FIELD)
+#undef STORE_ARRAY_FIELD
+  } else if (bank->layout == AOSOA_LAYOUT) {
+    ParticleBlock* block = &bank->blocks[pid / PARTICLE_BLOCK_SIZE];
+    const int lane = pid % PARTICLE_BLOCK_SIZE;
+#define STORE_BLOCK_FIELD(type, name) block->name[lane] = particle->name;
+    PARTICLE_FIELDS(STORE_BLOCK_FIELD)
+#undef STORE_BLOCK_FIELD
+  } else {
+    pack_particle(pad, x_off, y_off, edgex, edgey, particle,
+                  &bank->compact[pid]);
+  }
 }
+#endif
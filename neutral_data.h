@@ -34,14 +34,63 @@
 
 enum { PARTICLE_SENT, PARTICLE_DEAD, PARTICLE_CENSUS, PARTICLE_CONTINUE };
 
+// The particle tracking algorithms that can be selected at runtime
+enum { HISTORY_BASED, EVENT_BASED, HYBRID_BASED, TILED_BASED, DELTA_BASED };
+
+// The schedulers that distribute particle histories between threads
+enum { STATIC_SCHEDULER, WORK_STEALING_SCHEDULER };
+
+// The orderings the particle bank can be sorted into before each timestep
+enum { NO_SORT, CELL_SORT, MORTON_SORT };
+
+// The strategies for accumulating the energy deposition tally
+enum { ATOMIC_TALLY, PRIVATE_TALLY, REPRODUCIBLE_TALLY };
+
+// When the tallies of ranks replicating the domain are reduced
+enum { RUN_REDUCTION, TIMESTEP_REDUCTION, NONBLOCKING_REDUCTION };
+
+// The layouts the particle bank can be stored in, where the validated compact
+// layout also tracks the full-precision bank to compare their tallies
+enum { FULL_LAYOUT, COMPACT_LAYOUT, VALIDATED_COMPACT_LAYOUT };
+
+// The layouts the CPU kernels can hold the full-precision particle bank in
+enum { AOS_LAYOUT, SOA_LAYOUT, AOSOA_LAYOUT };
+
+// The number of particles in each block of the AoSoA layout, so that one field
+// of a block of doubles fills an AVX-512 register
+#define PARTICLE_BLOCK_SIZE 8
+
+// The reactions of the unionized energy grid, whose values are stored side
+// by side for each key, with the reactions of further nuclides following on
+enum { SCATTER_REACTION, ABSORB_REACTION, NREACTIONS };
+
 // Represents a cross sectional table for resonance data
 typedef struct {
   double* keys;
-  double* values;
+  double* values;   // The nreactions values of each key, side by side
   int nentries;
+  int nreactions;
+
+  // The hash grid of uniform bins in log energy, each bin holding the range of
+  // entries it spans so that a lookup only searches within the bin
+  int* bin_entries;     // The entry holding each bin's lower bound, nbins + 1
+  int nbins;            // The number of bins, 0 searches the whole table
+  double log_key_min;   // The log of the smallest key
+  double inv_bin_width; // The number of bins per unit of log energy
 
 } CrossSection;
 
+// A rectangle of uniform density from the problem definition, painted over
+// the regions listed before it
+typedef struct {
+  double x0;      // The left border
+  double y0;      // The bottom border
+  double x1;      // The right border
+  double y1;      // The top border
+  double density; // The density inside the region
+
+} ProblemRegion;
+
 #ifdef SoA
 
 // Represents an individual particle
@@ -57,6 +106,8 @@ typedef struct {
   int* cellx;               // x position in mesh
   int* celly;               // y position in mesh
   int* dead;                // particle is dead
+  int* scatter_cs_index;    // entry of the last scattering lookup, or -1
+  int* absorb_cs_index;     // entry of the last absorption lookup, or -1
 
 } Particle;
 
@@ -75,15 +126,146 @@ typedef struct {
   int cellx;               // x position in mesh
   int celly;               // y position in mesh
   int dead;                // particle is dead
+  int scatter_cs_index;    // entry of the last scattering lookup, or -1
+  int absorb_cs_index;     // entry of the last absorption lookup, or -1
 
 } Particle;
 
 #endif
 
+// A particle stored with its position relative to its cell and its direction
+// in single precision, fitting a cache line. The energy, weight and timings
+// stay in double precision as they accumulate over the whole history.
+typedef struct {
+  double energy;                   // energy
+  double weight;                   // weight of the particle
+  double dt_to_census;             // the time until census is reached
+  double mfp_to_collision;         // the mean free paths until a collision
+  float x;                         // x offset in the cell, as a fraction of it
+  float y;                         // y offset in the cell, as a fraction of it
+  float omega_x;                   // x direction
+  float omega_y;                   // y direction
+  int cellx;                       // x position in mesh
+  int celly;                       // y position in mesh
+  int scatter_cs_index;            // entry of the last scattering lookup, or -1
+  signed int absorb_cs_index : 31; // entry of the last absorption lookup, or -1
+  unsigned int dead : 1;           // particle is dead
+
+} CompactParticle;
+
+// The fields of a particle, expanded by FIELD(type, name) to declare and copy
+// the fields of each layout of the particle bank
+#define PARTICLE_FIELDS(FIELD)                                                 \
+  FIELD(double, x)                                                             \
+  FIELD(double, y)                                                             \
+  FIELD(double, omega_x)                                                       \
+  FIELD(double, omega_y)                                                       \
+  FIELD(double, energy)                                                        \
+  FIELD(double, weight)                                                        \
+  FIELD(double, dt_to_census)                                                  \
+  FIELD(double, mfp_to_collision)                                              \
+  FIELD(int, cellx)                                                            \
+  FIELD(int, celly)                                                            \
+  FIELD(int, dead)                                                             \
+  FIELD(int, scatter_cs_index)                                                 \
+  FIELD(int, absorb_cs_index)
+
+#define PARTICLE_ARRAY_FIELD(type, name) type* name;
+#define PARTICLE_BLOCK_FIELD(type, name) type name[PARTICLE_BLOCK_SIZE];
+
+// The particles stored as an array for each field
+typedef struct { PARTICLE_FIELDS(PARTICLE_ARRAY_FIELD) } ParticleArrays;
+
+// A block of PARTICLE_BLOCK_SIZE particles stored as an array for each field
+typedef struct { PARTICLE_FIELDS(PARTICLE_BLOCK_FIELD) } ParticleBlock;
+
+// The particle bank when it is held outside of the AoS array of particles,
+// where the AoS layout is the compact layout
+typedef struct {
+  int layout;               // AOS_LAYOUT, SOA_LAYOUT or AOSOA_LAYOUT
+  int nparticles;           // The particles held by the bank
+  ParticleArrays arrays;    // The fields of the SoA layout
+  ParticleBlock* blocks;    // The blocks of the AoSoA layout
+  CompactParticle* compact; // The particles of the compact layout
+
+} ParticleBank;
+
+// Runtime options that select between the transport algorithms
+typedef struct {
+  int transport_mode;    // The particle tracking algorithm to use
+  int hybrid_threshold;  // Live particles at which hybrid switches, 0 tunes
+  int scheduler;         // STATIC_SCHEDULER or WORK_STEALING_SCHEDULER
+  int particle_sort;     // NO_SORT, CELL_SORT or MORTON_SORT
+  int tile_size;         // The width and height of the tiles in cells
+  int tally_mode;        // ATOMIC_TALLY, PRIVATE_TALLY or REPRODUCIBLE_TALLY
+  int flux_tally;        // Accumulate the track-length scalar flux tally
+  int load_balance;      // Timesteps between rebalances of the ranks, 0 never
+  int replicated_domain; // Every rank holds the mesh and a slice of particles
+  int tally_reduction;   // RUN, TIMESTEP or NONBLOCKING_REDUCTION
+  int cs_hash_bins;      // Bins of the log-energy hash grid, 0 binary search
+  int cs_benchmark;      // Lookups timed against the binary search, 0 none
+  int cs_unionized;      // Look up every reaction on one unionized grid
+  int macro_cells;       // Cross the facets of uniform regions in one step
+  int csg_geometry;      // Track against the problem regions, not the cells
+  int tally_nx;          // Columns of the tally mesh, 0 the transport mesh
+  int tally_ny;          // Rows of the tally mesh, 0 the transport mesh
+  int compact_layout;    // FULL, COMPACT or VALIDATED_COMPACT_LAYOUT
+  int particle_layout;   // AOS, SOA or AOSOA_LAYOUT of the particle bank
+  int simd_kernels;      // Batch the event kernels through SIMD lanes
+
+  // The global identifier of the rank's first particle
+  uint64_t particle_key_offset;
+
+  // The powers of two that reproducible tally contributions are rounded to
+  double tally_unit;
+  double flux_unit;
+
+  // The measured cost of a history-based event, used to tune the hybrid
+  double history_event_cost;
+
+  // The largest density on the rank, zero when tracking from facet to facet
+  double majorant_density;
+
+  // The unionized grid of the scattering and absorption tables, NULL when the
+  // tables are searched separately
+  const CrossSection* unionized_table;
+
+  // The material of each cell, laid out as the density, NULL when the mesh has
+  // more distinct densities than the map holds
+  uint8_t* cell_material;
+
+  // The density and number density of each material
+  double* material_density;
+  double* material_number_density;
+
+  // The level of the largest uniform macro-cell holding each cell, laid out as
+  // the density, NULL when particles stop at every facet
+  const uint8_t* macro_cell_level;
+
+  // The tally column of each column of cells and the tally row of each row,
+  // NULL when the tally mesh is the transport mesh
+  int* tally_cell_x;
+  int* tally_cell_y;
+
+  // The lanes of the SIMD kernels selected for the CPU, 0 when the event-based
+  // sweeps use the scalar kernels
+  int simd_lanes;
+
+  // The problem regions tracked against when csg_geometry is set
+  ProblemRegion* problem_regions;
+  int nproblem_regions;
+
+  // The particle bank when it is held outside of the AoS array, NULL when the
+  // kernels track the AoS array
+  ParticleBank* bank;
+
+} TransportOptions;
+
 // Contains the configuration and state data for the application
 typedef struct {
   CrossSection* cs_scatter_table;
   CrossSection* cs_absorb_table;
+  CrossSection* cs_unionized_table; // NULL unless cs_unionized is set
   Particle* local_particles;
 
   double initial_energy;
@@ -95,8 +277,14 @@ typedef struct {
   double* scalar_flux_tally;
   double* energy_deposition_tally;
 
+  // The local columns and rows of the tallies
+  int tally_nx;
+  int tally_ny;
+
   const char* neutral_params_filename;
 
+  TransportOptions options;
+
   uint64_t* nfacets_reduce_array;
   uint64_t* ncollisions_reduce_array;
   uint64_t* nprocessed_reduce_array;
@@ -113,4 +301,42 @@ MPI_Datatype particle_type;
 // Initialises all of the Neutral-specific data structures.
 void initialise_neutral_data(NeutralData* bright_data, Mesh* mesh);
 
+#ifndef SoA
+// Stores a particle in the compact layout, relative to its local cell
+void pack_particle(const int pad, const int x_off, const int y_off,
+                   const double* edgex, const double* edgey,
+                   const Particle* particle, CompactParticle* compact);
+
+// Restores a particle stored in the compact layout to full precision
+void unpack_particle(const int pad, const int x_off, const int y_off,
+                     const double* edgex, const double* edgey,
+                     const CompactParticle* compact, Particle* particle);
+
+// Loads a particle from the bank in full precision
+void load_particle(const ParticleBank* bank, const int pid, const int pad,
+                   const int x_off, const int y_off, const double* edgex,
+                   const double* edgey, Particle* particle);
+
+// Stores a particle in the bank
+void store_particle(ParticleBank* bank, const int pid, const int pad,
+                    const int x_off, const int y_off, const double* edgex,
+                    const double* edgey, const Particle* particle);
+#endif
+
+// Repartitions the mesh between the ranks by the cost each rank measured over
+// the last timestep, moving the tallies, density and particles to match
+void balance_load(NeutralData* neutral_data, Mesh* mesh, double** density,
+                  const uint64_t cost);
+
+// Gives every rank the whole mesh, in place of the spatial decomposition
+void replicate_domain(Mesh* mesh);
+
+// Starts reducing the tallies of the ranks replicating the domain onto the
+// master rank, completing the reduction unless it is nonblocking
+void reduce_replicated_tallies(NeutralData* neutral_data, Mesh* mesh,
+                               const int nonblocking);
+
+// Completes any outstanding reduction of the replicated tallies
+void complete_replicated_tallies(NeutralData* neutral_data);
+
 #endif
@@ -0,0 +1,66 @@
+#include "neutral.h"
+#include "../../comms.h"
+#include "../../shared.h"
+#include "../neutral_interface.h"
+#include <float.h>
+#include <math.h>
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// Times lookups of a cross section table through the log-energy hash grid
+// against the binary search of the whole table
+void benchmark_cs_lookup(const CrossSection* cs, const int nlookups) {
+
+  if (!cs->nbins) {
+    printf("Cross section benchmark needs cs_hash_bins to be set\n");
+    return;
+  }
+
+  double* energies = (double*)malloc(sizeof(double) * nlookups);
+  if (!energies) {
+    TERMINATE("Could not allocate the cross section benchmark energies.\n");
+  }
+
+  // Energies are spread uniformly in log energy across the table, the same
+  // random numbers giving both searches the same energies
+  const double log_key_max = log(cs->keys[cs->nentries - 1]);
+#pragma omp parallel for
+  for (int ii = 0; ii < nlookups; ++ii) {
+    double rn[NRANDOM_NUMBERS];
+    generate_random_numbers(ii, 0, 0, &rn[0], &rn[1]);
+    energies[ii] = min(
+        exp(cs->log_key_min + rn[0] * (log_key_max - cs->log_key_min)),
+        cs->keys[cs->nentries - 1] * (1.0 - DBL_EPSILON));
+  }
+
+  uint64_t binary_sum = 0;
+  const double binary_start = omp_get_wtime();
+#pragma omp parallel for reduction(+ : binary_sum)
+  for (int ii = 0; ii < nlookups; ++ii) {
+    binary_sum += cs_entry_binary(cs, energies[ii]);
+  }
+  const double binary_time = omp_get_wtime() - binary_start;
+
+  uint64_t hashed_sum = 0;
+  const double hashed_start = omp_get_wtime();
+#pragma omp parallel for reduction(+ : hashed_sum)
+  for (int ii = 0; ii < nlookups; ++ii) {
+    hashed_sum += cs_entry_hashed(cs, energies[ii]);
+  }
+  const double hashed_time = omp_get_wtime() - hashed_start;
+
+  // Both searches must find the same entries
+  if (binary_sum != hashed_sum) {
+    TERMINATE("The hashed cross section lookup disagrees with the binary "
+              "search.\n");
+  }
+
+  printf("Cross section lookup of %d entries in %d bins, %d lookups\n",
+         cs->nentries, cs->nbins, nlookups);
+  printf("Binary search %.2fns, hash grid %.2fns per lookup, speedup %.2fx\n",
+         1.0e9 * binary_time / nlookups, 1.0e9 * hashed_time / nlookups,
+         binary_time / hashed_time);
+
+  free(energies);
+}
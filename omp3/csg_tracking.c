@@ -0,0 +1,396 @@
+#include "neutral.h"
+#include "../../comms.h"
+#include "../../shared.h"
+#include "../neutral_interface.h"
+#include <float.h>
+#include <math.h>
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// Finds the density of the last problem region holding a position, which is
+// painted over the regions before it
+static inline double region_density(const double x, const double y,
+                                    const TransportOptions* options);
+
+// Finds the distance along a direction to the nearest border of a problem
+// region, ignoring any border the position already lies on
+static inline double distance_to_region_border(
+    const double x, const double y, const double omega_x,
+    const double omega_y, const double omega_x_inv, const double omega_y_inv,
+    const TransportOptions* options);
+
+// Finds the distances along the particle's direction to the nearest border of
+// a problem region and to the border of the rank [x0, x1) x [y0, y1)
+static inline void find_next_stop(const double x0, const double x1,
+                                  const double y0, const double y1,
+                                  const Particle* particle,
+                                  double* distance_to_border,
+                                  double* distance_to_facet, int* x_facet,
+                                  const TransportOptions* options);
+
+// Finds the distance to the nearest border of a problem region or the rank in
+// any direction, less the correction for the open bounds
+static inline double region_safety_distance(const double x0, const double x1,
+                                            const double y0, const double y1,
+                                            const double x, const double y,
+                                            const TransportOptions* options);
+
+// Splits the tally contributions of a flight between the cells it crosses,
+// leaving the particle's cell as the cell the flight ends in
+static inline void tally_flight(
+    const int nx, const int ny, const int pad, const int x_off,
+    const int y_off, const double inv_ntotal_particles, const double distance,
+    const double deposition_per_length, const double* edgex,
+    const double* edgey, Particle* particle, double* energy_deposition,
+    double* scalar_flux, double* energy_deposition_tally,
+    double* scalar_flux_tally, const TransportOptions* options);
+
+// Tracks a particle history to census against the borders of the problem
+// regions, where the particle only stops at collisions, region borders and
+// the borders of the rank, and its tally contributions are split between the
+// cells of the mesh it crosses
+int track_particle_csg(
+    const int global_nx, const int global_ny, const int nx, const int ny,
+    const uint64_t master_key, const int pad, const int x_off, const int y_off,
+    const double inv_ntotal_particles, const uint64_t pid,
+    const double* edgex, const double* edgey, Particle* particle,
+    CrossSection* cs_scatter_table, CrossSection* cs_absorb_table,
+    double* energy_deposition_tally, double* scalar_flux_tally,
+    uint64_t* counter, double* local_density, double* energy_deposition,
+    double* scalar_flux, double* number_density,
+    double* microscopic_cs_scatter, double* microscopic_cs_absorb,
+    double* macroscopic_cs_scatter, double* macroscopic_cs_absorb,
+    int* scatter_cs_index, int* absorb_cs_index, double* speed,
+    uint64_t* nfacets, uint64_t* ncollisions, const TransportOptions* options) {
+
+  double rn[NRANDOM_NUMBERS];
+
+  // The facets of the rank are the only facets the particle stops at
+  const double x0 = edgex[pad];
+  const double x1 = edgex[nx + pad];
+  const double y0 = edgey[pad];
+  const double y1 = edgey[ny + pad];
+
+  // The region is only found again after the particle stops at a border
+  int region_found = 0;
+
+  while (particle->dt_to_census > 0.0) {
+    int x_facet = 0;
+    int stops_found = 0;
+    double distance_to_border = DBL_MAX;
+    double distance_to_facet = DBL_MAX;
+
+    // The density is uniform until the next border, so it is taken from the
+    // middle of the flight, clear of the border the particle may lie on
+    if (!region_found) {
+      find_next_stop(x0, x1, y0, y1, particle, &distance_to_border,
+                     &distance_to_facet, &x_facet, options);
+      stops_found = 1;
+      const double half_stop = 0.5 * min(distance_to_border, distance_to_facet);
+      *local_density =
+          region_density(particle->x + half_stop * particle->omega_x,
+                         particle->y + half_stop * particle->omega_y,
+                         options);
+      *number_density = (*local_density * AVOGADROS / MOLAR_MASS);
+      *macroscopic_cs_scatter =
+          *number_density * *microscopic_cs_scatter * BARNS;
+      *macroscopic_cs_absorb = *number_density * *microscopic_cs_absorb * BARNS;
+      region_found = 1;
+    }
+
+    const double cell_mfp =
+        1.0 / (*macroscopic_cs_scatter + *macroscopic_cs_absorb);
+    const double distance_to_collision = particle->mfp_to_collision * cell_mfp;
+    const double distance_to_census = *speed * particle->dt_to_census;
+
+    // The borders are out of reach while the next event lies within the
+    // distance to the nearest of them in any direction
+    if (!stops_found &&
+        min(distance_to_collision, distance_to_census) >=
+            region_safety_distance(x0, x1, y0, y1, particle->x, particle->y,
+                                   options)) {
+      find_next_stop(x0, x1, y0, y1, particle, &distance_to_border,
+                     &distance_to_facet, &x_facet, options);
+    }
+
+    const double distance_to_stop = min(distance_to_border, distance_to_facet);
+    const double distance =
+        min(distance_to_collision, min(distance_to_stop, distance_to_census));
+
+    // The energy and density are fixed along the flight, so the deposition
+    // only scales with the path length through each cell
+    const double deposition_per_length = calculate_energy_deposition(
+        global_nx, nx, x_off, y_off, particle, inv_ntotal_particles, 1.0,
+        *number_density, *microscopic_cs_absorb,
+        *microscopic_cs_scatter + *microscopic_cs_absorb);
+    tally_flight(nx, ny, pad, x_off, y_off, inv_ntotal_particles, distance,
+                 deposition_per_length, edgex, edgey, particle,
+                 energy_deposition, scalar_flux, energy_deposition_tally,
+                 scalar_flux_tally, options);
+
+    particle->x += distance * particle->omega_x;
+    particle->y += distance * particle->omega_y;
+    particle->mfp_to_collision -= (distance / cell_mfp);
+    particle->dt_to_census -= (distance / *speed);
+
+    if (distance == distance_to_collision) {
+      (*ncollisions)++;
+
+      // A collision on a border may turn the particle back into either region
+      region_found = (distance != distance_to_stop);
+
+      // The particle is already at the collision site
+      const int result = collision_event(
+          global_nx, nx, x_off, y_off, options->particle_key_offset + pid,
+          master_key, inv_ntotal_particles, 0.0, cs_scatter_table,
+          cs_absorb_table, particle, counter, energy_deposition, scalar_flux,
+          number_density, microscopic_cs_scatter, microscopic_cs_absorb,
+          macroscopic_cs_scatter, macroscopic_cs_absorb,
+          energy_deposition_tally, scalar_flux_tally, scatter_cs_index,
+          absorb_cs_index, rn, speed, options);
+
+      if (result != PARTICLE_CONTINUE) {
+        return result;
+      }
+    } else if (distance == distance_to_facet) {
+      (*nfacets)++;
+
+      // Reflect at the problem boundary
+      if (x_facet) {
+        if ((particle->omega_x > 0.0 && particle->cellx >= global_nx - 1) ||
+            (particle->omega_x < 0.0 && particle->cellx <= 0)) {
+          particle->omega_x = -particle->omega_x;
+          continue;
+        }
+      } else {
+        if ((particle->omega_y > 0.0 && particle->celly >= global_ny - 1) ||
+            (particle->omega_y < 0.0 && particle->celly <= 0)) {
+          particle->omega_y = -particle->omega_y;
+          continue;
+        }
+      }
+
+      // Otherwise the particle crosses into the neighbouring rank, after
+      // tallying the contributions of the cell it is leaving
+      update_tallies(nx, x_off, y_off, particle, inv_ntotal_particles,
+                     *energy_deposition, *scalar_flux, energy_deposition_tally,
+                     scalar_flux_tally, options);
+      *energy_deposition = 0.0;
+      *scalar_flux = 0.0;
+      if (x_facet) {
+        particle->cellx += (particle->omega_x > 0.0) ? 1 : -1;
+      } else {
+        particle->celly += (particle->omega_y > 0.0) ? 1 : -1;
+      }
+      return PARTICLE_SENT;
+    } else if (distance == distance_to_border) {
+      // The particle stops at the border to find the density beyond it
+      (*nfacets)++;
+      region_found = 0;
+    } else {
+      particle->dt_to_census = 0.0;
+    }
+  }
+
+  update_tallies(nx, x_off, y_off, particle, inv_ntotal_particles,
+                 *energy_deposition, *scalar_flux, energy_deposition_tally,
+                 scalar_flux_tally, options);
+  *energy_deposition = 0.0;
+  *scalar_flux = 0.0;
+
+  return PARTICLE_CENSUS;
+}
+
+// Finds the density of the last problem region holding a position, which is
+// painted over the regions before it
+static inline double region_density(const double x, const double y,
+                                    const TransportOptions* options) {
+
+  for (int rr = options->nproblem_regions - 1; rr >= 0; --rr) {
+    const ProblemRegion* region = &options->problem_regions[rr];
+    if (x >= region->x0 && x < region->x1 && y >= region->y0 &&
+        y < region->y1) {
+      return region->density;
+    }
+  }
+  return 0.0;
+}
+
+// Finds the distance along a direction to the nearest border of a problem
+// region, ignoring any border the position already lies on
+static inline double distance_to_region_border(
+    const double x, const double y, const double omega_x,
+    const double omega_y, const double omega_x_inv, const double omega_y_inv,
+    const TransportOptions* options) {
+
+  double distance = DBL_MAX;
+  for (int rr = 0; rr < options->nproblem_regions; ++rr) {
+    const ProblemRegion* region = &options->problem_regions[rr];
+
+    // The ray is inside the region between where it enters the slabs of both
+    // axes and where it leaves either of them
+    double distance_in = -DBL_MAX;
+    double distance_out = DBL_MAX;
+    if (omega_x != 0.0) {
+      const double distance_x0 = (region->x0 - x) * omega_x_inv;
+      const double distance_x1 = (region->x1 - x) * omega_x_inv;
+      distance_in = min(distance_x0, distance_x1);
+      distance_out = max(distance_x0, distance_x1);
+    } else if (x < region->x0 || x >= region->x1) {
+      continue;
+    }
+    if (omega_y != 0.0) {
+      const double distance_y0 = (region->y0 - y) * omega_y_inv;
+      const double distance_y1 = (region->y1 - y) * omega_y_inv;
+      distance_in = max(distance_in, min(distance_y0, distance_y1));
+      distance_out = min(distance_out, max(distance_y0, distance_y1));
+    } else if (y < region->y0 || y >= region->y1) {
+      continue;
+    }
+
+    if (distance_in >= distance_out) {
+      continue;
+    }
+    if (distance_in > OPEN_BOUND_CORRECTION) {
+      distance = min(distance, distance_in);
+    } else if (distance_out > OPEN_BOUND_CORRECTION) {
+      distance = min(distance, distance_out);
+    }
+  }
+
+  return distance;
+}
+
+// Finds the distances along the particle's direction to the nearest border of
+// a problem region and to the border of the rank [x0, x1) x [y0, y1)
+static inline void find_next_stop(const double x0, const double x1,
+                                  const double y0, const double y1,
+                                  const Particle* particle,
+                                  double* distance_to_border,
+                                  double* distance_to_facet, int* x_facet,
+                                  const TransportOptions* options) {
+
+  const double omega_x_inv = 1.0 / particle->omega_x;
+  const double omega_y_inv = 1.0 / particle->omega_y;
+  *distance_to_border =
+      distance_to_region_border(particle->x, particle->y, particle->omega_x,
+                                particle->omega_y, omega_x_inv, omega_y_inv,
+                                options);
+
+  const double distance_to_x =
+      (particle->omega_x > 0.0)
+          ? (x1 - particle->x) * omega_x_inv
+          : (particle->omega_x < 0.0)
+                ? ((x0 - OPEN_BOUND_CORRECTION) - particle->x) * omega_x_inv
+                : DBL_MAX;
+  const double distance_to_y =
+      (particle->omega_y > 0.0)
+          ? (y1 - particle->y) * omega_y_inv
+          : (particle->omega_y < 0.0)
+                ? ((y0 - OPEN_BOUND_CORRECTION) - particle->y) * omega_y_inv
+                : DBL_MAX;
+  *x_facet = (distance_to_x < distance_to_y);
+  *distance_to_facet = (*x_facet) ? distance_to_x : distance_to_y;
+}
+
+// Finds the distance to the nearest border of a problem region or the rank in
+// any direction, less the correction for the open bounds
+static inline double region_safety_distance(const double x0, const double x1,
+                                            const double y0, const double y1,
+                                            const double x, const double y,
+                                            const TransportOptions* options) {
+
+  double safety = min(min(x - x0, x1 - x), min(y - y0, y1 - y));
+  for (int rr = 0; rr < options->nproblem_regions; ++rr) {
+    const ProblemRegion* region = &options->problem_regions[rr];
+    const double safety_x = min(fabs(x - region->x0), fabs(x - region->x1));
+    const double safety_y = min(fabs(y - region->y0), fabs(y - region->y1));
+    safety = min(safety, min(safety_x, safety_y));
+  }
+  return safety - OPEN_BOUND_CORRECTION;
+}
+
+// Splits the tally contributions of a flight between the cells it crosses,
+// leaving the particle's cell as the cell the flight ends in
+static inline void tally_flight(
+    const int nx, const int ny, const int pad, const int x_off,
+    const int y_off, const double inv_ntotal_particles, const double distance,
+    const double deposition_per_length, const double* edgex,
+    const double* edgey, Particle* particle, double* energy_deposition,
+    double* scalar_flux, double* energy_deposition_tally,
+    double* scalar_flux_tally, const TransportOptions* options) {
+
+  // A flight that stays clear of the facets of its cell crosses none of them
+  if (distance < calc_safety_distance(particle->x, particle->y, pad, x_off,
+                                      y_off, particle->cellx, particle->celly,
+                                      edgex, edgey)) {
+    *energy_deposition += deposition_per_length * distance;
+    if (scalar_flux_tally) {
+      *scalar_flux += particle->weight * distance;
+    }
+    return;
+  }
+
+  double distance_to_x_facet;
+  double distance_to_y_facet;
+  double x_facet_scale;
+  double y_facet_scale;
+  start_facet_traversal(particle->x, particle->y, pad, x_off, y_off,
+                        particle->omega_x, particle->omega_y, particle->cellx,
+                        particle->celly, edgex, edgey, &distance_to_x_facet,
+                        &distance_to_y_facet, &x_facet_scale, &y_facet_scale);
+  const int step_x = (particle->omega_x > 0.0) ? 1 : -1;
+  const int step_y = (particle->omega_y > 0.0) ? 1 : -1;
+
+  double travelled = 0.0;
+  while (1) {
+    const int x_facet = (distance_to_x_facet < distance_to_y_facet) ? 1 : 0;
+    const double distance_to_facet =
+        (x_facet) ? distance_to_x_facet : distance_to_y_facet;
+    if (distance_to_facet >= distance) {
+      break;
+    }
+
+    const int next_cellx = particle->cellx + ((x_facet) ? step_x : 0);
+    const int next_celly = particle->celly + ((x_facet) ? 0 : step_y);
+    // The flight ends at the border of the rank, so a crossing beyond it only
+    // comes from rounding
+    if (next_cellx < x_off || next_cellx >= x_off + nx ||
+        next_celly < y_off || next_celly >= y_off + ny) {
+      break;
+    }
+
+    const double path_length = distance_to_facet - travelled;
+    *energy_deposition += deposition_per_length * path_length;
+    if (scalar_flux_tally) {
+      *scalar_flux += particle->weight * path_length;
+    }
+    if (enters_tally_cell(particle->cellx, particle->celly, next_cellx,
+                          next_celly, options)) {
+      update_tallies(nx, x_off, y_off, particle, inv_ntotal_particles,
+                     *energy_deposition, *scalar_flux, energy_deposition_tally,
+                     scalar_flux_tally, options);
+      *energy_deposition = 0.0;
+      *scalar_flux = 0.0;
+    }
+
+    particle->cellx = next_cellx;
+    particle->celly = next_celly;
+    if (x_facet) {
+      const int c = next_cellx - x_off + pad;
+      distance_to_x_facet += (edgex[c + 1] - edgex[c]) * x_facet_scale;
+    } else {
+      const int c = next_celly - y_off + pad;
+      distance_to_y_facet += (edgey[c + 1] - edgey[c]) * y_facet_scale;
+    }
+    travelled = distance_to_facet;
+  }
+
+  // The rest of the flight lies in the cell it ends in
+  const double path_length = distance - travelled;
+  *energy_deposition += deposition_per_length * path_length;
+  if (scalar_flux_tally) {
+    *scalar_flux += particle->weight * path_length;
+  }
+}
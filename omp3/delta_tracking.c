@@ -0,0 +1,261 @@
+#include "neutral.h"
+#include "../../comms.h"
+#include "../../shared.h"
+#include "../neutral_interface.h"
+#include <float.h>
+#include <math.h>
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// Finds the cell of the local edges [edges[pad], edges[n + pad]) containing a
+// position, clamped to the local cells
+static inline int locate_cell(const int n, const int pad, const double* edges,
+                              const double position);
+
+// Moves the particle to a local cell, tallying the contributions gathered in
+// the tally cell it leaves
+static inline void enter_cell(const int nx, const int x_off, const int y_off,
+                              const int cellx, const int celly,
+                              const double inv_ntotal_particles,
+                              Particle* particle, double* energy_deposition,
+                              double* scalar_flux,
+                              double* energy_deposition_tally,
+                              double* scalar_flux_tally,
+                              const TransportOptions* options);
+
+// Determines the largest density on the rank, which bounds the macroscopic
+// cross sections a particle of any energy can see
+double calculate_majorant_density(const int nx, const int ny, const int pad,
+                                  const double* density) {
+
+  double max_density = 0.0;
+
+#pragma omp parallel for reduction(max : max_density)
+  for (int jj = pad; jj < ny + pad; ++jj) {
+    for (int ii = pad; ii < nx + pad; ++ii) {
+      max_density = max(max_density, density[jj * (nx + 2 * pad) + ii]);
+    }
+  }
+
+  return max_density;
+}
+
+// Tracks a particle history to census with Woodcock delta tracking, where
+// flights are sampled against the majorant cross section and the particle
+// only stops at real or virtual collisions and the borders of the rank
+int track_particle_delta(
+    const int global_nx, const int global_ny, const int nx, const int ny,
+    const uint64_t master_key, const int pad, const int x_off, const int y_off,
+    const double inv_ntotal_particles, const uint64_t pid,
+    const double* density, const double* edgex, const double* edgey,
+    Particle* particle, CrossSection* cs_scatter_table,
+    CrossSection* cs_absorb_table, double* energy_deposition_tally,
+    double* scalar_flux_tally, uint64_t* counter, double* local_density,
+    double* energy_deposition, double* scalar_flux, double* number_density,
+    double* microscopic_cs_scatter, double* microscopic_cs_absorb,
+    double* macroscopic_cs_scatter, double* macroscopic_cs_absorb,
+    int* scatter_cs_index, int* absorb_cs_index, double* speed,
+    uint64_t* nfacets, uint64_t* ncollisions, const TransportOptions* options) {
+
+  double rn[NRANDOM_NUMBERS];
+  const uint64_t pkey = options->particle_key_offset + pid;
+
+  const double majorant_number_density =
+      options->majorant_density * AVOGADROS / MOLAR_MASS;
+
+  // The facets of the rank are the only facets the particle stops at
+  const double x0 = edgex[pad];
+  const double x1 = edgex[nx + pad];
+  const double y0 = edgey[pad];
+  const double y1 = edgey[ny + pad];
+
+  while (particle->dt_to_census > 0.0) {
+    // The majorant only has to bound the density, as the microscopic cross
+    // sections are fixed between collisions
+    const double majorant_cs =
+        majorant_number_density *
+        (*microscopic_cs_scatter + *microscopic_cs_absorb) * BARNS;
+    const double majorant_mfp = 1.0 / majorant_cs;
+
+    // The mean free paths are consumed at the majorant's rate, which samples
+    // the same flights as tracking facet to facet
+    const double distance_to_collision =
+        particle->mfp_to_collision * majorant_mfp;
+    const double distance_to_census = *speed * particle->dt_to_census;
+
+    const double distance_to_x =
+        (particle->omega_x > 0.0)
+            ? (x1 - particle->x) / particle->omega_x
+            : (particle->omega_x < 0.0)
+                  ? ((x0 - OPEN_BOUND_CORRECTION) - particle->x) /
+                        particle->omega_x
+                  : DBL_MAX;
+    const double distance_to_y =
+        (particle->omega_y > 0.0)
+            ? (y1 - particle->y) / particle->omega_y
+            : (particle->omega_y < 0.0)
+                  ? ((y0 - OPEN_BOUND_CORRECTION) - particle->y) /
+                        particle->omega_y
+                  : DBL_MAX;
+    const int x_facet = (distance_to_x < distance_to_y);
+    const double distance_to_facet = x_facet ? distance_to_x : distance_to_y;
+
+    const double distance =
+        min(distance_to_collision, min(distance_to_facet, distance_to_census));
+
+    // The flight scores its length at a point chosen uniformly along it,
+    // which estimates the track length without visiting each cell crossed
+    generate_random_numbers(pkey, master_key, (*counter)++, &rn[0], &rn[1]);
+    const double score_x = particle->x + rn[0] * distance * particle->omega_x;
+    const double score_y = particle->y + rn[0] * distance * particle->omega_y;
+    int cellx = locate_cell(nx, pad, edgex, score_x);
+    int celly = locate_cell(ny, pad, edgey, score_y);
+    enter_cell(nx, x_off, y_off, cellx, celly, inv_ntotal_particles,
+               particle, energy_deposition, scalar_flux,
+               energy_deposition_tally, scalar_flux_tally, options);
+    double score_density;
+    double score_number_density;
+    cell_densities(density, (celly + pad) * (nx + 2 * pad) + (cellx + pad),
+                   &score_density, &score_number_density, options);
+    *energy_deposition += calculate_energy_deposition(
+        global_nx, nx, x_off, y_off, particle, inv_ntotal_particles, distance,
+        score_number_density, *microscopic_cs_absorb,
+        *microscopic_cs_scatter + *microscopic_cs_absorb);
+    if (scalar_flux_tally) {
+      *scalar_flux += particle->weight * distance;
+    }
+
+    particle->x += distance * particle->omega_x;
+    particle->y += distance * particle->omega_y;
+    particle->mfp_to_collision -= distance * majorant_cs;
+    particle->dt_to_census -= distance / *speed;
+
+    cellx = locate_cell(nx, pad, edgex, particle->x);
+    celly = locate_cell(ny, pad, edgey, particle->y);
+    enter_cell(nx, x_off, y_off, cellx, celly, inv_ntotal_particles,
+               particle, energy_deposition, scalar_flux,
+               energy_deposition_tally, scalar_flux_tally, options);
+
+    if (distance == distance_to_collision) {
+      cell_densities(density, (celly + pad) * (nx + 2 * pad) + (cellx + pad),
+                     local_density, number_density, options);
+
+      generate_random_numbers(pkey, master_key, (*counter)++, &rn[0], &rn[1]);
+
+      // The collision is virtual with the probability that the majorant
+      // exceeds the local cross section, and the flight just continues. The
+      // mean free paths are resampled against the scattering cross section
+      // they were first sampled against, at the last real collision, so the
+      // flight keeps its distribution whatever the density of the site
+      if (rn[0] * options->majorant_density >= *local_density) {
+        particle->mfp_to_collision = -log(rn[1]) / *macroscopic_cs_scatter;
+        continue;
+      }
+
+      // The cross sections of the collision site
+      *macroscopic_cs_scatter =
+          *number_density * (*microscopic_cs_scatter) * BARNS;
+      *macroscopic_cs_absorb =
+          *number_density * (*microscopic_cs_absorb) * BARNS;
+
+      (*ncollisions)++;
+
+      // The particle is already at the collision site
+      const int result = collision_event(
+          global_nx, nx, x_off, y_off, pkey, master_key, inv_ntotal_particles,
+          0.0, cs_scatter_table, cs_absorb_table, particle, counter,
+          energy_deposition, scalar_flux, number_density,
+          microscopic_cs_scatter, microscopic_cs_absorb,
+          macroscopic_cs_scatter, macroscopic_cs_absorb,
+          energy_deposition_tally, scalar_flux_tally, scatter_cs_index,
+          absorb_cs_index, rn, speed, options);
+
+      if (result != PARTICLE_CONTINUE) {
+        return result;
+      }
+    } else if (distance == distance_to_facet) {
+      (*nfacets)++;
+
+      // Reflect at the problem boundary
+      if (x_facet) {
+        if ((particle->omega_x > 0.0 && particle->cellx >= global_nx - 1) ||
+            (particle->omega_x < 0.0 && particle->cellx <= 0)) {
+          particle->omega_x = -particle->omega_x;
+          continue;
+        }
+      } else {
+        if ((particle->omega_y > 0.0 && particle->celly >= global_ny - 1) ||
+            (particle->omega_y < 0.0 && particle->celly <= 0)) {
+          particle->omega_y = -particle->omega_y;
+          continue;
+        }
+      }
+
+      // Otherwise the particle crosses into the neighbouring rank, after
+      // tallying the contributions of the cell it is leaving
+      update_tallies(nx, x_off, y_off, particle, inv_ntotal_particles,
+                     *energy_deposition, *scalar_flux, energy_deposition_tally,
+                     scalar_flux_tally, options);
+      *energy_deposition = 0.0;
+      *scalar_flux = 0.0;
+      if (x_facet) {
+        particle->cellx += (particle->omega_x > 0.0) ? 1 : -1;
+      } else {
+        particle->celly += (particle->omega_y > 0.0) ? 1 : -1;
+      }
+      return PARTICLE_SENT;
+    } else {
+      particle->dt_to_census = 0.0;
+    }
+  }
+
+  update_tallies(nx, x_off, y_off, particle, inv_ntotal_particles,
+                 *energy_deposition, *scalar_flux, energy_deposition_tally,
+                 scalar_flux_tally, options);
+  *energy_deposition = 0.0;
+  *scalar_flux = 0.0;
+
+  return PARTICLE_CENSUS;
+}
+
+// Finds the cell of the local edges [edges[pad], edges[n + pad]) containing a
+// position, clamped to the local cells
+static inline int locate_cell(const int n, const int pad, const double* edges,
+                              const double position) {
+
+  int lo = 0;
+  int hi = n;
+  while (hi - lo > 1) {
+    const int mid = (lo + hi) / 2;
+    if (position < edges[mid + pad]) {
+      hi = mid;
+    } else {
+      lo = mid;
+    }
+  }
+  return lo;
+}
+
+// Moves the particle to a local cell, tallying the contributions gathered in
+// the tally cell it leaves
+static inline void enter_cell(const int nx, const int x_off, const int y_off,
+                              const int cellx, const int celly,
+                              const double inv_ntotal_particles,
+                              Particle* particle, double* energy_deposition,
+                              double* scalar_flux,
+                              double* energy_deposition_tally,
+                              double* scalar_flux_tally,
+                              const TransportOptions* options) {
+
+  if (enters_tally_cell(particle->cellx, particle->celly, x_off + cellx,
+                        y_off + celly, options)) {
+    update_tallies(nx, x_off, y_off, particle, inv_ntotal_particles,
+                   *energy_deposition, *scalar_flux, energy_deposition_tally,
+                   scalar_flux_tally, options);
+    *energy_deposition = 0.0;
+    *scalar_flux = 0.0;
+  }
+  particle->cellx = x_off + cellx;
+  particle->celly = y_off + celly;
+}
@@ -0,0 +1,581 @@
+#include "neutral.h"
+#include "../../comms.h"
+#include "../../shared.h"
+#include "../neutral_interface.h"
+#include <math.h>
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// Determines the next event that each live particle will encounter
+static void classify_events(const int global_nx, const int pad,
+                            const int x_off, const int y_off, const int nlive,
+                            const int* live, Particle* particles,
+                            const double* edgex, const double* edgey,
+                            EventState* state);
+
+// Performs event-based sweeps until no particles are live, or until the live
+// population or the cost per event of a sweep crosses the given thresholds
+static int run_event_sweeps(
+    const int global_nx, const int global_ny, const int nx, const int ny,
+    const uint64_t master_key, const int pad, const int x_off, const int y_off,
+    const double inv_ntotal_particles, const int* neighbours,
+    const double* density, const double* edgex, const double* edgey,
+    const int nparticles_to_process, const int min_live,
+    const double max_event_cost, Particle* particles,
+    CrossSection* cs_scatter_table, CrossSection* cs_absorb_table,
+    double* energy_deposition_tally, double* scalar_flux_tally,
+    EventState* state, int** live, int** queue, uint64_t* nfacets,
+    uint64_t* ncollisions, uint64_t* nsweeps,
+    const TransportOptions* options);
+
+// Handles the current active batch of particles with event-based tracking
+void handle_particles_event_based(
+    const int global_nx, const int global_ny, const int nx, const int ny,
+    const uint64_t master_key, const int pad, const int x_off, const int y_off,
+    const int initial, const double dt, const int* neighbours,
+    const double* density, const double* edgex, const double* edgey,
+    uint64_t* facets, uint64_t* collisions, const int ntotal_particles,
+    const int nparticles_to_process, Particle* particles,
+    CrossSection* cs_scatter_table, CrossSection* cs_absorb_table,
+    double* energy_deposition_tally, double* scalar_flux_tally,
+    const TransportOptions* options) {
+
+  EventState state;
+  allocate_event_state(&state, nparticles_to_process);
+
+  // The live list and event queues are swapped after every sweep
+  int* live = (int*)malloc(sizeof(int) * nparticles_to_process);
+  int* queue = (int*)malloc(sizeof(int) * nparticles_to_process);
+  if (!live || !queue) {
+    TERMINATE("Could not allocate the event queues.\n");
+  }
+
+  const double inv_ntotal_particles = 1.0 / (double)ntotal_particles;
+
+  uint64_t nfacets = 0;
+  uint64_t ncollisions = 0;
+  uint64_t nsweeps = 0;
+
+  START_PROFILING(&compute_profile);
+  const uint64_t nparticles = initialise_event_state(
+      nx, master_key, pad, x_off, y_off, initial, dt, density,
+      nparticles_to_process, particles, cs_scatter_table, cs_absorb_table,
+      &state, live, options);
+  STOP_PROFILING(&compute_profile, "initialise events");
+
+  run_event_sweeps(global_nx, global_ny, nx, ny, master_key, pad, x_off, y_off,
+                   inv_ntotal_particles, neighbours, density, edgex, edgey,
+                   nparticles_to_process, 0, 0.0, particles, cs_scatter_table,
+                   cs_absorb_table, energy_deposition_tally, scalar_flux_tally,
+                   &state, &live, &queue, &nfacets, &ncollisions, &nsweeps,
+                   options);
+
+  // Store a total number of facets and collisions
+  *facets += nfacets;
+  *collisions += ncollisions;
+
+  printf("Particles  %llu\n", (unsigned long long)nparticles);
+  printf("Sweeps     %llu\n", (unsigned long long)nsweeps);
+
+  free(live);
+  free(queue);
+  store_cs_indices(nparticles_to_process, particles, &state);
+  deallocate_event_state(&state);
+}
+
+// Handles the current active batch of particles, starting with event-based
+// sweeps and finishing the remaining histories with history-based tracking
+void handle_particles_hybrid(
+    const int global_nx, const int global_ny, const int nx, const int ny,
+    const uint64_t master_key, const int pad, const int x_off, const int y_off,
+    const int initial, const double dt, const int* neighbours,
+    const double* density, const double* edgex, const double* edgey,
+    uint64_t* facets, uint64_t* collisions, const int ntotal_particles,
+    const int nparticles_to_process, Particle* particles,
+    CrossSection* cs_scatter_table, CrossSection* cs_absorb_table,
+    double* energy_deposition_tally, double* scalar_flux_tally,
+    TransportOptions* options) {
+
+  EventState state;
+  allocate_event_state(&state, nparticles_to_process);
+
+  int* live = (int*)malloc(sizeof(int) * nparticles_to_process);
+  int* queue = (int*)malloc(sizeof(int) * nparticles_to_process);
+  if (!live || !queue) {
+    TERMINATE("Could not allocate the event queues.\n");
+  }
+
+  const double inv_ntotal_particles = 1.0 / (double)ntotal_particles;
+
+  uint64_t nfacets = 0;
+  uint64_t ncollisions = 0;
+  uint64_t nsweeps = 0;
+
+  const double event_start = omp_get_wtime();
+
+  const uint64_t nparticles = initialise_event_state(
+      nx, master_key, pad, x_off, y_off, initial, dt, density,
+      nparticles_to_process, particles, cs_scatter_table, cs_absorb_table,
+      &state, live, options);
+
+  // A fixed threshold switches on the live population, otherwise the sweeps
+  // stop once their cost per event exceeds that of the last history phase
+  int min_live = options->hybrid_threshold;
+  double max_event_cost = 0.0;
+  if (min_live <= 0) {
+    if (options->history_event_cost > 0.0) {
+      min_live = 0;
+      max_event_cost = options->history_event_cost;
+    } else {
+      min_live = nparticles * HYBRID_INITIAL_FRACTION;
+    }
+  }
+
+  const int nlive = run_event_sweeps(
+      global_nx, global_ny, nx, ny, master_key, pad, x_off, y_off,
+      inv_ntotal_particles, neighbours, density, edgex, edgey,
+      nparticles_to_process, min_live, max_event_cost, particles,
+      cs_scatter_table, cs_absorb_table, energy_deposition_tally,
+      scalar_flux_tally, &state, &live, &queue, &nfacets, &ncollisions,
+      &nsweeps, options);
+
+  const double event_time = omp_get_wtime() - event_start;
+  const double history_start = omp_get_wtime();
+
+  uint64_t nhistory_facets = 0;
+  uint64_t nhistory_collisions = 0;
+  uint64_t nhistory_particles = 0;
+
+  // The remaining histories vary greatly in length so are handed out
+  // dynamically, resuming from the state left by the last sweep
+#pragma omp parallel for schedule(dynamic)                                    \
+    reduction(+ : nhistory_facets, nhistory_collisions, nhistory_particles)
+  for (int ii = 0; ii < nlive; ++ii) {
+    const int pid = live[ii];
+    Particle* particle = &particles[pid];
+
+    if (particle->dead) {
+      continue;
+    }
+
+    nhistory_particles++;
+
+    const int result = track_particle_history(
+        global_nx, global_ny, nx, ny, master_key, pad, x_off, y_off,
+        inv_ntotal_particles, pid, 0, 0, global_nx, global_ny, neighbours,
+        density, edgex, edgey, particle, cs_scatter_table, cs_absorb_table,
+        energy_deposition_tally, scalar_flux_tally, &state.counter[pid],
+        &state.local_density[pid], &state.energy_deposition[pid],
+        &state.scalar_flux[pid], &state.number_density[pid],
+        &state.microscopic_cs_scatter[pid], &state.microscopic_cs_absorb[pid],
+        &state.macroscopic_cs_scatter[pid], &state.macroscopic_cs_absorb[pid],
+        &state.scatter_cs_index[pid], &state.absorb_cs_index[pid],
+        &state.speed[pid], &nhistory_facets, &nhistory_collisions, options);
+
+    if (result == PARTICLE_SENT) {
+      send_and_mark_particle(pid, particle);
+    }
+  }
+
+  const double history_time = omp_get_wtime() - history_start;
+
+  // Every history ends in a census or an absorption, so count it as an event
+  const uint64_t nhistory_events =
+      nhistory_facets + nhistory_collisions + nhistory_particles;
+  if (options->hybrid_threshold <= 0 && nhistory_events > 0) {
+    options->history_event_cost = history_time / nhistory_events;
+  }
+
+  // Store a total number of facets and collisions
+  *facets += nfacets + nhistory_facets;
+  *collisions += ncollisions + nhistory_collisions;
+
+  printf("Particles  %llu\n", (unsigned long long)nparticles);
+  printf("Switched to history-based after %llu sweeps with %d live particles\n",
+         (unsigned long long)nsweeps, nlive);
+  printf("Event phase    %.4fs\n", event_time);
+  printf("History phase  %.4fs\n", history_time);
+
+  free(live);
+  free(queue);
+  store_cs_indices(nparticles_to_process, particles, &state);
+  deallocate_event_state(&state);
+}
+
+// Performs event-based sweeps until no particles are live, or until the live
+// population or the cost per event of a sweep crosses the given thresholds
+static int run_event_sweeps(
+    const int global_nx, const int global_ny, const int nx, const int ny,
+    const uint64_t master_key, const int pad, const int x_off, const int y_off,
+    const double inv_ntotal_particles, const int* neighbours,
+    const double* density, const double* edgex, const double* edgey,
+    const int nparticles_to_process, const int min_live,
+    const double max_event_cost, Particle* particles,
+    CrossSection* cs_scatter_table, CrossSection* cs_absorb_table,
+    double* energy_deposition_tally, double* scalar_flux_tally,
+    EventState* state, int** live, int** queue, uint64_t* nfacets,
+    uint64_t* ncollisions, uint64_t* nsweeps,
+    const TransportOptions* options) {
+
+  // Every particle is considered live until the first classification
+  int nlive = nparticles_to_process;
+
+  while (nlive > 0 && nlive > min_live) {
+    const double sweep_start = omp_get_wtime();
+
+    START_PROFILING(&compute_profile);
+    if (options->simd_lanes) {
+      classify_events_simd(global_nx, pad, x_off, y_off, nlive, *live,
+                           particles, edgex, edgey, state, options);
+    } else {
+      classify_events(global_nx, pad, x_off, y_off, nlive, *live, particles,
+                      edgex, edgey, state);
+    }
+
+    int nqueue[NEVENT_TYPES];
+    partition_particles(nlive, *live, state->event, NEVENT_TYPES, *queue,
+                        nqueue);
+    STOP_PROFILING(&compute_profile, "classify events");
+
+    // The queues are stored contiguously in the order of the event types
+    const int* collision_queue = &(*queue)[0];
+    const int* facet_queue = &collision_queue[nqueue[COLLISION_EVENT]];
+    const int* census_queue = &facet_queue[nqueue[FACET_EVENT]];
+
+    START_PROFILING(&compute_profile);
+    if (options->simd_lanes) {
+      collision_events_simd(nx, x_off, y_off, master_key,
+                            inv_ntotal_particles, nqueue[COLLISION_EVENT],
+                            collision_queue, cs_scatter_table,
+                            cs_absorb_table, particles, state,
+                            energy_deposition_tally, scalar_flux_tally,
+                            options);
+    } else {
+#pragma omp parallel for
+      for (int ii = 0; ii < nqueue[COLLISION_EVENT]; ++ii) {
+        const int pid = collision_queue[ii];
+        double rn[NRANDOM_NUMBERS];
+        collision_event(
+            global_nx, nx, x_off, y_off, options->particle_key_offset + pid,
+            master_key, inv_ntotal_particles, state->distance_to_event[pid],
+            cs_scatter_table, cs_absorb_table, &particles[pid],
+            &state->counter[pid], &state->energy_deposition[pid],
+            &state->scalar_flux[pid], &state->number_density[pid],
+            &state->microscopic_cs_scatter[pid],
+            &state->microscopic_cs_absorb[pid],
+            &state->macroscopic_cs_scatter[pid],
+            &state->macroscopic_cs_absorb[pid], energy_deposition_tally,
+            scalar_flux_tally, &state->scatter_cs_index[pid],
+            &state->absorb_cs_index[pid], rn, &state->speed[pid], options);
+      }
+    }
+    STOP_PROFILING(&compute_profile, "collision events");
+
+    START_PROFILING(&compute_profile);
+    if (options->simd_lanes) {
+      facet_events_simd(global_nx, global_ny, nx, ny, x_off, y_off,
+                        inv_ntotal_particles, nqueue[FACET_EVENT],
+                        facet_queue, density, particles, state,
+                        energy_deposition_tally, scalar_flux_tally, options);
+    } else {
+#pragma omp parallel for
+      for (int ii = 0; ii < nqueue[FACET_EVENT]; ++ii) {
+        const int pid = facet_queue[ii];
+        int cellx;
+        int celly;
+        const int result = facet_event(
+            global_nx, global_ny, nx, ny, x_off, y_off, inv_ntotal_particles,
+            state->distance_to_event[pid], state->speed[pid],
+            state->cell_mfp[pid], state->x_facet[pid], density, neighbours,
+            &particles[pid], &state->energy_deposition[pid],
+            &state->scalar_flux[pid], &state->number_density[pid],
+            &state->microscopic_cs_scatter[pid],
+            &state->microscopic_cs_absorb[pid],
+            &state->macroscopic_cs_scatter[pid],
+            &state->macroscopic_cs_absorb[pid], energy_deposition_tally,
+            scalar_flux_tally, &cellx, &celly, &state->local_density[pid],
+            options);
+
+        // Particles that leave the rank are classified as dead next sweep
+        if (result == PARTICLE_SENT) {
+          send_and_mark_particle(pid, &particles[pid]);
+        }
+      }
+    }
+    STOP_PROFILING(&compute_profile, "facet events");
+
+    START_PROFILING(&compute_profile);
+#pragma omp parallel for
+    for (int ii = 0; ii < nqueue[CENSUS_EVENT]; ++ii) {
+      const int pid = census_queue[ii];
+      census_event(global_nx, nx, x_off, y_off, inv_ntotal_particles,
+                   state->distance_to_event[pid], state->cell_mfp[pid],
+                   &particles[pid], &state->energy_deposition[pid],
+                   &state->scalar_flux[pid], &state->number_density[pid],
+                   &state->microscopic_cs_scatter[pid],
+                   &state->microscopic_cs_absorb[pid],
+                   energy_deposition_tally, scalar_flux_tally, options);
+    }
+    STOP_PROFILING(&compute_profile, "census events");
+
+    const int nevents = nqueue[COLLISION_EVENT] + nqueue[FACET_EVENT] +
+                        nqueue[CENSUS_EVENT];
+    *ncollisions += nqueue[COLLISION_EVENT];
+    *nfacets += nqueue[FACET_EVENT];
+    (*nsweeps)++;
+
+    // Particles that collided or crossed a facet remain live, and the
+    // classification step will drop any that were absorbed
+    int* temp = *live;
+    *live = *queue;
+    *queue = temp;
+    nlive = nqueue[COLLISION_EVENT] + nqueue[FACET_EVENT];
+
+    // Stop sweeping once the synchronisation overhead outweighs the batching
+    const double sweep_time = omp_get_wtime() - sweep_start;
+    if (max_event_cost > 0.0 && nevents > 0 &&
+        sweep_time / nevents > max_event_cost) {
+      break;
+    }
+  }
+
+  return nlive;
+}
+
+// Initialises the per-particle state ahead of the first sweep
+uint64_t initialise_event_state(
+    const int nx, const uint64_t master_key, const int pad, const int x_off,
+    const int y_off, const int initial, const double dt,
+    const double* density, const int nparticles_to_process,
+    Particle* particles, CrossSection* cs_scatter_table,
+    CrossSection* cs_absorb_table, EventState* state, int* live,
+    const TransportOptions* options) {
+
+  uint64_t nparticles = 0;
+
+#pragma omp parallel for reduction(+ : nparticles)
+  for (int pp = 0; pp < nparticles_to_process; ++pp) {
+    Particle* particle = &particles[pp];
+    live[pp] = pp;
+
+    // The entries of the particle's last lookups start the search
+    state->scatter_cs_index[pp] = particle->scatter_cs_index;
+    state->absorb_cs_index[pp] = particle->absorb_cs_index;
+
+    if (particle->dead) {
+      continue;
+    }
+
+    nparticles++;
+
+    // Determine the current cell
+    const int cellx = particle->cellx - x_off + pad;
+    const int celly = particle->celly - y_off + pad;
+    cell_densities(density, celly * (nx + 2 * pad) + cellx,
+                   &state->local_density[pp], &state->number_density[pp],
+                   options);
+
+    // Fetch the cross sections and prepare related quantities
+    microscopic_cs_for_reactions(
+        cs_scatter_table, cs_absorb_table, particle->energy,
+        &state->scatter_cs_index[pp], &state->absorb_cs_index[pp],
+        &state->microscopic_cs_scatter[pp], &state->microscopic_cs_absorb[pp],
+        options);
+    state->macroscopic_cs_scatter[pp] =
+        state->number_density[pp] * state->microscopic_cs_scatter[pp] * BARNS;
+    state->macroscopic_cs_absorb[pp] =
+        state->number_density[pp] * state->microscopic_cs_absorb[pp] * BARNS;
+    state->speed[pp] =
+        sqrt((2.0 * particle->energy * eV_TO_J) / PARTICLE_MASS);
+    state->energy_deposition[pp] = 0.0;
+    state->scalar_flux[pp] = 0.0;
+    state->counter[pp] = 0;
+
+    // Set time to census and MFPs until collision, unless travelled
+    // particle
+    if (initial) {
+      double rn[NRANDOM_NUMBERS];
+      particle->dt_to_census = dt;
+      generate_random_numbers(options->particle_key_offset + pp, master_key,
+                              state->counter[pp]++, &rn[0], &rn[1]);
+      particle->mfp_to_collision =
+          -log(rn[0]) / state->macroscopic_cs_scatter[pp];
+    }
+  }
+
+  return nparticles;
+}
+
+// Determines the next event that each live particle will encounter
+static void classify_events(const int global_nx, const int pad,
+                            const int x_off, const int y_off, const int nlive,
+                            const int* live, Particle* particles,
+                            const double* edgex, const double* edgey,
+                            EventState* state) {
+
+#pragma omp parallel for
+  for (int ii = 0; ii < nlive; ++ii) {
+    const int pid = live[ii];
+    Particle* particle = &particles[pid];
+
+    // Absorbed particles and those already at census leave the live list
+    if (particle->dead || particle->dt_to_census <= 0.0) {
+      state->event[pid] = NO_EVENT;
+      continue;
+    }
+
+    const double speed = state->speed[pid];
+    const double cell_mfp = 1.0 / (state->macroscopic_cs_scatter[pid] +
+                                   state->macroscopic_cs_absorb[pid]);
+    state->cell_mfp[pid] = cell_mfp;
+
+    // Work out the distance until the particle hits a facet
+    double distance_to_facet = 0.0;
+    calc_distance_to_facet(global_nx, particle->x, particle->y, pad, x_off,
+                           y_off, particle->omega_x, particle->omega_y,
+                           particle->cellx, particle->celly,
+                           &distance_to_facet, &state->x_facet[pid], edgex,
+                           edgey);
+
+    const double distance_to_collision = particle->mfp_to_collision * cell_mfp;
+    const double distance_to_census = speed * particle->dt_to_census;
+
+    // The event selection matches the over-particles tracking loop
+    if (distance_to_collision < distance_to_facet &&
+        distance_to_collision < distance_to_census) {
+      state->event[pid] = COLLISION_EVENT;
+      state->distance_to_event[pid] = distance_to_collision;
+    } else if (distance_to_facet < distance_to_census) {
+      state->event[pid] = FACET_EVENT;
+      state->distance_to_event[pid] = distance_to_facet;
+    } else {
+      state->event[pid] = CENSUS_EVENT;
+      state->distance_to_event[pid] = distance_to_census;
+    }
+  }
+}
+
+// Stably partitions the particles into a queue for each key, with the queues
+// stored contiguously in key order
+void partition_particles(const int nparticles, const int* pids,
+                         const int* key, const int nkeys, int* queue,
+                         int* nqueue) {
+
+  int nthreads = 0;
+#pragma omp parallel
+  { nthreads = omp_get_num_threads(); }
+
+  int* offsets = (int*)malloc(sizeof(int) * nthreads * nkeys);
+  if (!offsets) {
+    TERMINATE("Could not allocate the partition offsets.\n");
+  }
+
+#pragma omp parallel
+  {
+    const int tid = omp_get_thread_num();
+    const int np_per_thread = nparticles / nthreads;
+    const int np_remainder = nparticles % nthreads;
+    const int start = tid * np_per_thread + min(tid, np_remainder);
+    const int end = start + np_per_thread + (tid < np_remainder);
+    int* thread_offsets = &offsets[tid * nkeys];
+
+    // Count the keys of the particles in this thread's slice
+    for (int kk = 0; kk < nkeys; ++kk) {
+      thread_offsets[kk] = 0;
+    }
+    for (int ii = start; ii < end; ++ii) {
+      thread_offsets[key[pids[ii]]]++;
+    }
+
+#pragma omp barrier
+#pragma omp single
+    {
+      // Exclusive scan over the keys, then over threads within each key
+      int off = 0;
+      for (int kk = 0; kk < nkeys; ++kk) {
+        nqueue[kk] = 0;
+        for (int tt = 0; tt < nthreads; ++tt) {
+          const int count = offsets[tt * nkeys + kk];
+          offsets[tt * nkeys + kk] = off;
+          nqueue[kk] += count;
+          off += count;
+        }
+      }
+    }
+
+    for (int ii = start; ii < end; ++ii) {
+      const int pid = pids[ii];
+      queue[thread_offsets[key[pid]]++] = pid;
+    }
+  }
+
+  free(offsets);
+}
+
+// Allocates the per-particle state for event-based tracking
+size_t allocate_event_state(EventState* state, const int nparticles) {
+  const size_t ndoubles = 11;
+  const size_t nints = 4;
+  state->local_density = (double*)malloc(sizeof(double) * nparticles);
+  state->number_density = (double*)malloc(sizeof(double) * nparticles);
+  state->microscopic_cs_scatter = (double*)malloc(sizeof(double) * nparticles);
+  state->microscopic_cs_absorb = (double*)malloc(sizeof(double) * nparticles);
+  state->macroscopic_cs_scatter = (double*)malloc(sizeof(double) * nparticles);
+  state->macroscopic_cs_absorb = (double*)malloc(sizeof(double) * nparticles);
+  state->speed = (double*)malloc(sizeof(double) * nparticles);
+  state->energy_deposition = (double*)malloc(sizeof(double) * nparticles);
+  state->scalar_flux = (double*)malloc(sizeof(double) * nparticles);
+  state->cell_mfp = (double*)malloc(sizeof(double) * nparticles);
+  state->distance_to_event = (double*)malloc(sizeof(double) * nparticles);
+  state->counter = (uint64_t*)malloc(sizeof(uint64_t) * nparticles);
+  state->scatter_cs_index = (int*)malloc(sizeof(int) * nparticles);
+  state->absorb_cs_index = (int*)malloc(sizeof(int) * nparticles);
+  state->x_facet = (int*)malloc(sizeof(int) * nparticles);
+  state->event = (int*)malloc(sizeof(int) * nparticles);
+
+  if (!state->local_density || !state->number_density ||
+      !state->microscopic_cs_scatter || !state->microscopic_cs_absorb ||
+      !state->macroscopic_cs_scatter || !state->macroscopic_cs_absorb ||
+      !state->speed || !state->energy_deposition || !state->scalar_flux ||
+      !state->cell_mfp || !state->distance_to_event || !state->counter ||
+      !state->scatter_cs_index || !state->absorb_cs_index ||
+      !state->x_facet || !state->event) {
+    TERMINATE("Could not allocate the event-based particle state.\n");
+  }
+
+  return nparticles * (sizeof(double) * ndoubles + sizeof(uint64_t) +
+                       sizeof(int) * nints);
+}
+
+// Stores the entries of each particle's last lookups with the particle, to
+// start its searches in the next timestep
+void store_cs_indices(const int nparticles, Particle* particles,
+                      const EventState* state) {
+
+#pragma omp parallel for
+  for (int pp = 0; pp < nparticles; ++pp) {
+    particles[pp].scatter_cs_index = state->scatter_cs_index[pp];
+    particles[pp].absorb_cs_index = state->absorb_cs_index[pp];
+  }
+}
+
+// Deallocates the per-particle state for event-based tracking
+void deallocate_event_state(EventState* state) {
+  free(state->local_density);
+  free(state->number_density);
+  free(state->microscopic_cs_scatter);
+  free(state->microscopic_cs_absorb);
+  free(state->macroscopic_cs_scatter);
+  free(state->macroscopic_cs_absorb);
+  free(state->speed);
+  free(state->energy_deposition);
+  free(state->scalar_flux);
+  free(state->cell_mfp);
+  free(state->distance_to_event);
+  free(state->counter);
+  free(state->scatter_cs_index);
+  free(state->absorb_cs_index);
+  free(state->x_facet);
+  free(state->event);
+}
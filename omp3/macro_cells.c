@@ -0,0 +1,205 @@
+#include "neutral.h"
+#include "../../comms.h"
+#include "../../shared.h"
+#include "../neutral_interface.h"
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// The levels built for the local mesh, and the mesh they were built for
+static uint8_t* levels = NULL;
+static const double* levels_density = NULL;
+static int levels_extent[4];
+
+// Builds the quadtree of uniform macro-cells over the local cells, where a
+// macro-cell of level L is an aligned block of 2^L x 2^L cells, clipped to the
+// mesh, that all have the same density. Each cell holds the level of the
+// largest macro-cell containing it, which is the leaf of the quadtree it lies
+// in, so the tree needs no nodes of its own.
+const uint8_t* build_macro_cells(const int nx, const int ny, const int pad,
+                                 const int x_off, const int y_off,
+                                 const double* density) {
+
+  const int extent[4] = {nx, ny, x_off, y_off};
+  if (density == levels_density && extent[0] == levels_extent[0] &&
+      extent[1] == levels_extent[1] && extent[2] == levels_extent[2] &&
+      extent[3] == levels_extent[3]) {
+    return levels;
+  }
+
+  START_PROFILING(&compute_profile);
+
+  levels_density = density;
+  for (int ii = 0; ii < 4; ++ii) {
+    levels_extent[ii] = extent[ii];
+  }
+
+  const int ncells = (nx + 2 * pad) * (ny + 2 * pad);
+
+  free(levels);
+  levels = (uint8_t*)malloc(sizeof(uint8_t) * ncells);
+  if (!levels) {
+    TERMINATE("Could not allocate the macro-cell levels.\n");
+  }
+
+#pragma omp parallel for
+  for (int ii = 0; ii < ncells; ++ii) {
+    levels[ii] = 0;
+  }
+
+  // Each level merges the four macro-cells of the level below into one when
+  // they are all whole and share a density, stopping once nothing merges
+  int nlevels = 0;
+  for (int level = 1; (1 << (level - 1)) < max(nx, ny); ++level) {
+    const int size = 1 << level;
+    const int half = size / 2;
+    const int nblocksx = (nx + size - 1) / size;
+    const int nblocksy = (ny + size - 1) / size;
+
+    int nmerged = 0;
+#pragma omp parallel for reduction(+ : nmerged)
+    for (int bb = 0; bb < nblocksx * nblocksy; ++bb) {
+      const int x0 = (bb % nblocksx) * size;
+      const int y0 = (bb / nblocksx) * size;
+      const double block_density =
+          density[(y0 + pad) * (nx + 2 * pad) + (x0 + pad)];
+
+      // The quarters that lie beyond the mesh are clipped away
+      int uniform = 1;
+      for (int qq = 0; qq < 4 && uniform; ++qq) {
+        const int qx = x0 + (qq % 2) * half;
+        const int qy = y0 + (qq / 2) * half;
+        if (qx < nx && qy < ny) {
+          const int index = (qy + pad) * (nx + 2 * pad) + (qx + pad);
+          uniform =
+              (levels[index] == level - 1 && density[index] == block_density);
+        }
+      }
+      if (!uniform) {
+        continue;
+      }
+
+      for (int jj = y0; jj < min(y0 + size, ny); ++jj) {
+        for (int ii = x0; ii < min(x0 + size, nx); ++ii) {
+          levels[(jj + pad) * (nx + 2 * pad) + (ii + pad)] = level;
+        }
+      }
+      nmerged++;
+    }
+
+    if (!nmerged) {
+      break;
+    }
+    nlevels = level;
+  }
+
+  STOP_PROFILING(&compute_profile, "build macro-cells");
+
+  printf("Macro-cells of up to %d x %d cells over %d cells\n", 1 << nlevels,
+         1 << nlevels, nx * ny);
+
+  return levels;
+}
+
+// Crosses the facets inside the uniform macro-cell holding the particle, and
+// inside the tile [tile_x0, tile_x1) x [tile_y0, tile_y1), without stopping
+// until the next collision or census. The path through each cell crossed is
+// tallied as the particle leaves its tally cell, and the particle moves once to
+// the last facet crossed, returning the distance travelled.
+double cross_macro_cell(
+    const int global_nx, const int nx, const int ny, const int pad,
+    const int x_off, const int y_off, const int tile_x0, const int tile_y0,
+    const int tile_x1, const int tile_y1, const double inv_ntotal_particles,
+    const double distance_to_collision, const double distance_to_census,
+    const double cell_mfp, const double speed, const double* edgex,
+    const double* edgey, const double x_facet_scale,
+    const double y_facet_scale, Particle* particle,
+    double* distance_to_x_facet, double* distance_to_y_facet,
+    double* energy_deposition, double* scalar_flux,
+    const double number_density, const double microscopic_cs_scatter,
+    const double microscopic_cs_absorb, double* energy_deposition_tally,
+    double* scalar_flux_tally, uint64_t* nfacets,
+    const TransportOptions* options) {
+
+  const int cellx = particle->cellx - x_off;
+  const int celly = particle->celly - y_off;
+  const int level =
+      options->macro_cell_level[(celly + pad) * (nx + 2 * pad) + (cellx + pad)];
+  if (!level) {
+    return 0.0;
+  }
+
+  // The macro-cell never extends beyond the rank, so no facet crossed inside
+  // it reflects the particle or sends it to a neighbour
+  const int size = 1 << level;
+  const int block_x0 = x_off + (cellx & ~(size - 1));
+  const int block_y0 = y_off + (celly & ~(size - 1));
+  const int x0 = max(block_x0, tile_x0);
+  const int y0 = max(block_y0, tile_y0);
+  const int x1 = min(min(block_x0 + size, x_off + nx), tile_x1);
+  const int y1 = min(min(block_y0 + size, y_off + ny), tile_y1);
+  const int step_x = (particle->omega_x > 0.0) ? 1 : -1;
+  const int step_y = (particle->omega_y > 0.0) ? 1 : -1;
+
+  // The energy and cross sections are fixed inside the macro-cell, so the
+  // deposition only scales with the path length
+  const double deposition_per_length = calculate_energy_deposition(
+      global_nx, nx, x_off, y_off, particle, inv_ntotal_particles, 1.0,
+      number_density, microscopic_cs_absorb,
+      microscopic_cs_scatter + microscopic_cs_absorb);
+
+  double distance = 0.0;
+  while (1) {
+    const int x_facet = (*distance_to_x_facet < *distance_to_y_facet) ? 1 : 0;
+    const double distance_to_facet =
+        (x_facet) ? *distance_to_x_facet : *distance_to_y_facet;
+    if (distance_to_facet > distance_to_collision ||
+        distance_to_facet >= distance_to_census) {
+      break;
+    }
+
+    const int next_cellx = particle->cellx + ((x_facet) ? step_x : 0);
+    const int next_celly = particle->celly + ((x_facet) ? 0 : step_y);
+    if (next_cellx < x0 || next_cellx >= x1 || next_celly < y0 ||
+        next_celly >= y1) {
+      break;
+    }
+
+    (*nfacets)++;
+
+    const double path_length = distance_to_facet - distance;
+    *energy_deposition += deposition_per_length * path_length;
+    if (scalar_flux_tally) {
+      *scalar_flux += particle->weight * path_length;
+    }
+    if (enters_tally_cell(particle->cellx, particle->celly, next_cellx,
+                          next_celly, options)) {
+      update_tallies(nx, x_off, y_off, particle, inv_ntotal_particles,
+                     *energy_deposition, *scalar_flux, energy_deposition_tally,
+                     scalar_flux_tally, options);
+      *energy_deposition = 0.0;
+      *scalar_flux = 0.0;
+    }
+
+    // The next facet along the crossed axis is the far side of the new cell
+    particle->cellx = next_cellx;
+    particle->celly = next_celly;
+    if (x_facet) {
+      const int c = next_cellx - x_off + pad;
+      *distance_to_x_facet += (edgex[c + 1] - edgex[c]) * x_facet_scale;
+    } else {
+      const int c = next_celly - y_off + pad;
+      *distance_to_y_facet += (edgey[c + 1] - edgey[c]) * y_facet_scale;
+    }
+    distance = distance_to_facet;
+  }
+
+  particle->x += distance * particle->omega_x;
+  particle->y += distance * particle->omega_y;
+  particle->mfp_to_collision -= (distance / cell_mfp);
+  particle->dt_to_census -= (distance / speed);
+  *distance_to_x_facet -= distance;
+  *distance_to_y_facet -= distance;
+
+  return distance;
+}
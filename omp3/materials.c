@@ -0,0 +1,130 @@
+#include "neutral.h"
+#include "../../comms.h"
+#include "../../shared.h"
+#include "../neutral_interface.h"
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// The local mesh the material map was built for
+static const double* mapped_density = NULL;
+static int mapped_extent[4];
+
+// Finds the material with a density, or -1 when there is none
+static inline int find_material(const int nmaterials, const double* densities,
+                                const double density);
+
+// Builds the material map of the local cells, unless the mesh is unchanged
+// since it was last built
+void map_materials(const int nx, const int ny, const int pad, const int x_off,
+                   const int y_off, const double* density,
+                   TransportOptions* options) {
+
+  const int extent[4] = {nx, ny, x_off, y_off};
+  if (density == mapped_density && extent[0] == mapped_extent[0] &&
+      extent[1] == mapped_extent[1] && extent[2] == mapped_extent[2] &&
+      extent[3] == mapped_extent[3]) {
+    return;
+  }
+
+  START_PROFILING(&compute_profile);
+
+  free(options->cell_material);
+  options->cell_material = NULL;
+  mapped_density = density;
+  for (int ii = 0; ii < 4; ++ii) {
+    mapped_extent[ii] = extent[ii];
+  }
+
+  if (!options->material_density) {
+    options->material_density = (double*)malloc(sizeof(double) * MAX_MATERIALS);
+    options->material_number_density =
+        (double*)malloc(sizeof(double) * MAX_MATERIALS);
+    if (!options->material_density || !options->material_number_density) {
+      TERMINATE("Could not allocate the materials.\n");
+    }
+  }
+  double* material_density = options->material_density;
+  double* material_number_density = options->material_number_density;
+
+  const int ncells = (nx + 2 * pad) * (ny + 2 * pad);
+
+  // Each thread gathers the distinct densities of its cells, which are then
+  // merged, giving up as soon as there are too many to map
+  int nmaterials = 0;
+  int overflow = 0;
+#pragma omp parallel
+  {
+    double densities[MAX_MATERIALS];
+    int ndensities = 0;
+    int full = 0;
+
+#pragma omp for
+    for (int ii = 0; ii < ncells; ++ii) {
+      if (full || find_material(ndensities, densities, density[ii]) >= 0) {
+        continue;
+      }
+      if (ndensities == MAX_MATERIALS) {
+        full = 1;
+        continue;
+      }
+      densities[ndensities++] = density[ii];
+    }
+
+#pragma omp critical
+    for (int dd = 0; dd < ndensities && !overflow; ++dd) {
+      if (full) {
+        overflow = 1;
+        break;
+      }
+      if (find_material(nmaterials, material_density, densities[dd]) >= 0) {
+        continue;
+      }
+      if (nmaterials == MAX_MATERIALS) {
+        overflow = 1;
+        break;
+      }
+      material_density[nmaterials++] = densities[dd];
+    }
+  }
+
+  if (overflow) {
+    STOP_PROFILING(&compute_profile, "map materials");
+    printf("Material map disabled, more than %d distinct densities\n",
+           MAX_MATERIALS);
+    return;
+  }
+
+  for (int mm = 0; mm < nmaterials; ++mm) {
+    material_number_density[mm] =
+        (material_density[mm] * AVOGADROS / MOLAR_MASS);
+  }
+
+  uint8_t* cell_material = (uint8_t*)malloc(sizeof(uint8_t) * ncells);
+  if (!cell_material) {
+    TERMINATE("Could not allocate the material map.\n");
+  }
+
+#pragma omp parallel for
+  for (int ii = 0; ii < ncells; ++ii) {
+    cell_material[ii] =
+        find_material(nmaterials, material_density, density[ii]);
+  }
+  options->cell_material = cell_material;
+
+  STOP_PROFILING(&compute_profile, "map materials");
+
+  printf("Material map of %d materials over %d cells\n", nmaterials, ncells);
+}
+
+// Finds the material with a density, or -1 when there is none
+static inline int find_material(const int nmaterials, const double* densities,
+                                const double density) {
+
+  for (int mm = 0; mm < nmaterials; ++mm) {
+    if (densities[mm] == density) {
+      return mm;
+    }
+  }
+  return -1;
+}
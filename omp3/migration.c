@@ -0,0 +1,413 @@
+#include "neutral.h"
+#include "../../comms.h"
+#include "../../shared.h"
+#include "../neutral_interface.h"
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef MPI
+#include "mpi.h"
+#endif
+
+// The faces of a two dimensional rank that particles can leave through
+#define NFACES 4
+
+// The particles waiting to be sent to the neighbouring ranks
+ParticleExchange particle_exchange = {NULL, 0, 0};
+
+#ifdef MPI
+// The double-buffered mailboxes that carry particles to and from a neighbour,
+// where one mailbox is filled or emptied while the other is in flight
+typedef struct {
+  Particle* send[2];
+  Particle* recv[2];
+  MPI_Request send_request[2];
+  MPI_Request recv_request[2];
+
+  int nsend;        // The particles packed into the current send mailbox
+  int send_mailbox; // The send mailbox currently being packed
+  int recv_mailbox; // The receive mailbox that will be matched next
+} Mailboxes;
+
+// The mailboxes for each face of the rank
+static Mailboxes mailboxes[NFACES];
+
+// Posts the receives for every neighbour so that batches arriving while the
+// rank is tracking its own particles can land without waiting on it
+static void open_mailboxes(const int* neighbours);
+
+// Completes the outstanding sends and withdraws the unmatched receives
+static void close_mailboxes(const int* neighbours);
+
+// Packs the particles that have left the rank into the mailboxes of their
+// neighbours and sends every mailbox that holds particles
+static uint64_t post_departures(const int nx, const int ny, const int x_off,
+                                const int y_off, const int* neighbours,
+                                const int capacity, int* nparticles,
+                                Particle* particles, uint64_t* nreceived,
+                                uint64_t* nmessages);
+
+// Appends the contents of every mailbox that has arrived to the end of the
+// bank, reposting the receive on the emptied mailbox
+static uint64_t collect_arrivals(const int* neighbours, const int capacity,
+                                 int* nparticles, Particle* particles);
+
+// Removes the particles that are dead or have left the rank from the bank
+static void compact_particles(int* nparticles, Particle* particles);
+#endif
+
+// Marks a particle that has left the rank to be sent to its neighbour
+void send_and_mark_particle(const int pid, Particle* particle) {
+  int off;
+#pragma omp atomic capture
+  off = particle_exchange.nsent++;
+  particle_exchange.pids[off] = pid;
+
+  // The particle no longer belongs to this rank
+  particle->dead = 1;
+}
+
+// Prepares the exchange of the particles that leave the rank this timestep
+void initialise_particle_exchange(const int capacity) {
+  if (particle_exchange.capacity < capacity) {
+    free(particle_exchange.pids);
+    particle_exchange.pids = (int*)malloc(sizeof(int) * capacity);
+    if (!particle_exchange.pids) {
+      TERMINATE("Could not allocate the particle exchange.\n");
+    }
+    particle_exchange.capacity = capacity;
+  }
+  particle_exchange.nsent = 0;
+}
+
+// Determines whether the rank shares a border with any other rank
+int has_neighbouring_ranks(const int* neighbours) {
+  return neighbours[NORTH] != EDGE || neighbours[EAST] != EDGE ||
+         neighbours[SOUTH] != EDGE || neighbours[WEST] != EDGE;
+}
+
+// Tracks the particles from ntracked onwards while exchanging the particles
+// that leave the rank with the neighbouring ranks, resuming the received
+// particles until every rank reaches census
+void migrate_particles(
+    const int global_nx, const int global_ny, const int nx, const int ny,
+    const uint64_t master_key, const int pad, const int x_off, const int y_off,
+    const double dt, const int* neighbours, const double* density,
+    const double* edgex, const double* edgey, uint64_t* facets,
+    uint64_t* collisions, const int ntotal_particles, const int ntracked,
+    int* nparticles, Particle* particles, CrossSection* cs_scatter_table,
+    CrossSection* cs_absorb_table, double* energy_deposition_tally,
+    double* scalar_flux_tally, const TransportOptions* options) {
+
+  if (!has_neighbouring_ranks(neighbours)) {
+    return;
+  }
+
+#ifdef MPI
+  uint64_t nfacets = 0;
+  uint64_t ncollisions = 0;
+  uint64_t nlocal = 0;
+  uint64_t nsent = 0;
+  uint64_t nreceived = 0;
+  uint64_t nmessages = 0;
+  int nwaves = 0;
+
+  // The particles before nbank are the rank's own and start their timestep,
+  // while those appended after it resume the timestep of another rank
+  const int nbank = *nparticles;
+  int next = ntracked;
+
+  // The appended particles restart their random number streams, so they are
+  // keyed past the particles of every rank, in a range of the rank's own,
+  // rather than replaying the streams of the particles in the same slots
+  int rank;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  TransportOptions resumed_options = *options;
+  resumed_options.particle_key_offset =
+      (uint64_t)(rank + 1) * 2 * ntotal_particles;
+
+  // The counts are only known to be settled once two consecutive waves agree
+  uint64_t wave_counts[2];
+  uint64_t wave_totals[2];
+  uint64_t last_totals[2] = {UINT64_MAX, UINT64_MAX};
+  MPI_Request wave_request = MPI_REQUEST_NULL;
+
+  START_PROFILING(&comms_profile);
+  open_mailboxes(neighbours);
+  STOP_PROFILING(&comms_profile, "open mailboxes");
+
+  while (1) {
+    // Track the next block, never mixing the rank's own particles with the
+    // received particles as they start differently
+    if (next < *nparticles) {
+      const int initial = (next < nbank);
+      const int end =
+          min(next + MIGRATION_BLOCK_SIZE, initial ? nbank : *nparticles);
+
+      START_PROFILING(&compute_profile);
+#pragma omp parallel for schedule(dynamic, PARTICLE_CHUNK_SIZE)              \
+    reduction(+ : nfacets, ncollisions, nlocal)
+      for (int pid = next; pid < end; ++pid) {
+        Particle* particle = &particles[pid];
+        if (particle->dead) {
+          continue;
+        }
+        nlocal += initial;
+        handle_particle(global_nx, global_ny, nx, ny, master_key, pad, x_off,
+                        y_off, initial, dt, pid, neighbours, density, edgex,
+                        edgey, ntotal_particles, particle, cs_scatter_table,
+                        cs_absorb_table, energy_deposition_tally,
+                        scalar_flux_tally, &nfacets, &ncollisions,
+                        initial ? options : &resumed_options);
+      }
+      STOP_PROFILING(&compute_profile, "track particle block");
+
+      next = end;
+    }
+
+    START_PROFILING(&comms_profile);
+    nsent += post_departures(nx, ny, x_off, y_off, neighbours,
+                             2 * ntotal_particles, nparticles, particles,
+                             &nreceived, &nmessages);
+    nreceived += collect_arrivals(neighbours, 2 * ntotal_particles,
+                                  nparticles, particles);
+    STOP_PROFILING(&comms_profile, "exchange mailboxes");
+
+    if (next < *nparticles) {
+      continue;
+    }
+
+    // An idle rank joins a termination wave, and carries on receiving while
+    // the reduction progresses rather than waiting on the other ranks
+    if (wave_request == MPI_REQUEST_NULL) {
+      wave_counts[0] = nsent;
+      wave_counts[1] = nreceived;
+      MPI_Iallreduce(wave_counts, wave_totals, 2, MPI_UINT64_T, MPI_SUM,
+                     MPI_COMM_WORLD, &wave_request);
+      nwaves++;
+    } else {
+      int complete = 0;
+      MPI_Test(&wave_request, &complete, MPI_STATUS_IGNORE);
+      if (complete) {
+        // No particle is in flight and no rank has received work since the
+        // previous wave, so every rank has reached census
+        if (wave_totals[0] == wave_totals[1] &&
+            wave_totals[0] == last_totals[0] &&
+            wave_totals[1] == last_totals[1]) {
+          break;
+        }
+        last_totals[0] = wave_totals[0];
+        last_totals[1] = wave_totals[1];
+      }
+    }
+  }
+
+  START_PROFILING(&comms_profile);
+  close_mailboxes(neighbours);
+  STOP_PROFILING(&comms_profile, "close mailboxes");
+
+  // Store a total number of facets and collisions
+  *facets += nfacets;
+  *collisions += ncollisions;
+
+  // The departed particles leave holes that would otherwise accumulate
+  if (nsent || nreceived) {
+    START_PROFILING(&compute_profile);
+    compact_particles(nparticles, particles);
+    STOP_PROFILING(&compute_profile, "compact particles");
+  }
+
+  if (ntracked == 0) {
+    printf("Particles  %llu\n", (unsigned long long)nlocal);
+  }
+  printf("Migration  sent %llu, received %llu, %llu messages, %d waves, "
+         "%.4fMB\n",
+         (unsigned long long)nsent, (unsigned long long)nreceived,
+         (unsigned long long)nmessages, nwaves,
+         (nsent + nreceived) * sizeof(Particle) / (1024.0 * 1024.0));
+#endif
+}
+
+#ifdef MPI
+// Posts the receives for every neighbour so that batches arriving while the
+// rank is tracking its own particles can land without waiting on it
+static void open_mailboxes(const int* neighbours) {
+  for (int ff = 0; ff < NFACES; ++ff) {
+    if (neighbours[ff] == EDGE) {
+      continue;
+    }
+
+    Mailboxes* mb = &mailboxes[ff];
+    for (int mm = 0; mm < 2; ++mm) {
+      if (!mb->send[mm]) {
+        mb->send[mm] =
+            (Particle*)malloc(sizeof(Particle) * PARTICLE_MAILBOX_SIZE);
+        mb->recv[mm] =
+            (Particle*)malloc(sizeof(Particle) * PARTICLE_MAILBOX_SIZE);
+        if (!mb->send[mm] || !mb->recv[mm]) {
+          TERMINATE("Could not allocate the particle mailboxes.\n");
+        }
+      }
+      mb->send_request[mm] = MPI_REQUEST_NULL;
+      MPI_Irecv(mb->recv[mm], PARTICLE_MAILBOX_SIZE * sizeof(Particle),
+                MPI_BYTE, neighbours[ff], TAG_PARTICLE, MPI_COMM_WORLD,
+                &mb->recv_request[mm]);
+    }
+    mb->nsend = 0;
+    mb->send_mailbox = 0;
+    mb->recv_mailbox = 0;
+  }
+}
+
+// Completes the outstanding sends and withdraws the unmatched receives
+static void close_mailboxes(const int* neighbours) {
+  for (int ff = 0; ff < NFACES; ++ff) {
+    if (neighbours[ff] == EDGE) {
+      continue;
+    }
+
+    // Every particle sent has been received, so the receives still posted
+    // can never be matched this timestep
+    Mailboxes* mb = &mailboxes[ff];
+    MPI_Waitall(2, mb->send_request, MPI_STATUSES_IGNORE);
+    for (int mm = 0; mm < 2; ++mm) {
+      MPI_Cancel(&mb->recv_request[mm]);
+      MPI_Wait(&mb->recv_request[mm], MPI_STATUS_IGNORE);
+    }
+  }
+}
+
+// Sends the mailbox being packed, and frees up the other mailbox for packing
+static void send_mailbox(Mailboxes* mb, const int neighbour,
+                         const int* neighbours, const int capacity,
+                         int* nparticles, Particle* particles,
+                         uint64_t* nreceived, uint64_t* nmessages) {
+  const int mm = mb->send_mailbox;
+  MPI_Isend(mb->send[mm], mb->nsend * sizeof(Particle), MPI_BYTE, neighbour,
+            TAG_PARTICLE, MPI_COMM_WORLD, &mb->send_request[mm]);
+  (*nmessages)++;
+
+  mb->send_mailbox = 1 - mm;
+  mb->nsend = 0;
+
+  // When both mailboxes are in flight the arrivals keep being collected, as
+  // the neighbour may itself be waiting on this rank to repost a receive
+  while (1) {
+    int complete = 0;
+    MPI_Test(&mb->send_request[mb->send_mailbox], &complete,
+             MPI_STATUS_IGNORE);
+    if (complete) {
+      break;
+    }
+    *nreceived +=
+        collect_arrivals(neighbours, capacity, nparticles, particles);
+  }
+}
+
+// Packs the particles that have left the rank into the mailboxes of their
+// neighbours and sends every mailbox that holds particles
+static uint64_t post_departures(const int nx, const int ny, const int x_off,
+                                const int y_off, const int* neighbours,
+                                const int capacity, int* nparticles,
+                                Particle* particles, uint64_t* nreceived,
+                                uint64_t* nmessages) {
+
+  const int nsent = particle_exchange.nsent;
+  for (int ii = 0; ii < nsent; ++ii) {
+    const Particle* particle = &particles[particle_exchange.pids[ii]];
+
+    // The direction the particle left in determines the neighbour it goes to
+    int face;
+    if (particle->cellx < x_off) {
+      face = WEST;
+    } else if (particle->cellx >= x_off + nx) {
+      face = EAST;
+    } else if (particle->celly < y_off) {
+      face = SOUTH;
+    } else {
+      face = NORTH;
+    }
+
+    Mailboxes* mb = &mailboxes[face];
+    Particle* packed = &mb->send[mb->send_mailbox][mb->nsend++];
+    *packed = *particle;
+    packed->dead = 0;
+
+    if (mb->nsend == PARTICLE_MAILBOX_SIZE) {
+      send_mailbox(mb, neighbours[face], neighbours, capacity, nparticles,
+                   particles, nreceived, nmessages);
+    }
+  }
+  particle_exchange.nsent = 0;
+
+  // Partially filled mailboxes are sent rather than held back, so that the
+  // neighbours are never left idle waiting on them
+  for (int ff = 0; ff < NFACES; ++ff) {
+    if (neighbours[ff] != EDGE && mailboxes[ff].nsend) {
+      send_mailbox(&mailboxes[ff], neighbours[ff], neighbours, capacity,
+                   nparticles, particles, nreceived, nmessages);
+    }
+  }
+
+  return nsent;
+}
+
+// Appends the contents of every mailbox that has arrived to the end of the
+// bank, reposting the receive on the emptied mailbox
+static uint64_t collect_arrivals(const int* neighbours, const int capacity,
+                                 int* nparticles, Particle* particles) {
+
+  uint64_t nreceived = 0;
+  for (int ff = 0; ff < NFACES; ++ff) {
+    if (neighbours[ff] == EDGE) {
+      continue;
+    }
+
+    // The receives are matched in the order they were posted, so only the
+    // older of the two mailboxes can have arrived first
+    Mailboxes* mb = &mailboxes[ff];
+    while (1) {
+      const int mm = mb->recv_mailbox;
+      int complete = 0;
+      MPI_Status status;
+      MPI_Test(&mb->recv_request[mm], &complete, &status);
+      if (!complete) {
+        break;
+      }
+
+      int nbytes = 0;
+      MPI_Get_count(&status, MPI_BYTE, &nbytes);
+      const int nrecv = nbytes / sizeof(Particle);
+      if (*nparticles + nrecv > capacity) {
+        TERMINATE("The particle bank cannot hold the received particles.\n");
+      }
+      memcpy(&particles[*nparticles], mb->recv[mm], nbytes);
+      *nparticles += nrecv;
+      nreceived += nrecv;
+
+      MPI_Irecv(mb->recv[mm], PARTICLE_MAILBOX_SIZE * sizeof(Particle),
+                MPI_BYTE, neighbours[ff], TAG_PARTICLE, MPI_COMM_WORLD,
+                &mb->recv_request[mm]);
+      mb->recv_mailbox = 1 - mm;
+    }
+  }
+
+  return nreceived;
+}
+
+// Removes the particles that are dead or have left the rank from the bank
+static void compact_particles(int* nparticles, Particle* particles) {
+  int nlive = 0;
+  for (int pp = 0; pp < *nparticles; ++pp) {
+    if (!particles[pp].dead) {
+      if (pp != nlive) {
+        particles[nlive] = particles[pp];
+      }
+      nlive++;
+    }
+  }
+  *nparticles = nlive;
+}
+#endif
@@ -23,20 +23,150 @@ void solve_transport_2d(
     const int* neighbours, Particle* particles, const double* density,
     const double* edgex, const double* edgey, const double* edgedx,
     const double* edgedy, CrossSection* cs_scatter_table,
-    CrossSection* cs_absorb_table, double* energy_deposition_tally,
+    CrossSection* cs_absorb_table, CrossSection* cs_unionized_table,
+    double* energy_deposition_tally, double* scalar_flux_tally,
     uint64_t* reduce_array0, uint64_t* reduce_array1, uint64_t* reduce_array2,
-    uint64_t* facet_events, uint64_t* collision_events) {
+    uint64_t* facet_events, uint64_t* collision_events,
+    TransportOptions* options) {
+
+  // The lookups search the unionized grid when the tables share one
+  options->unionized_table = cs_unionized_table;
+
+  // The few distinct densities of the problem regions are read through the
+  // material map, which is rebuilt when the mesh has been rebalanced
+  map_materials(nx, ny, pad, x_off, y_off, density, options);
+
+  // Contributions are gathered onto the tally mesh when it is coarser than
+  // the transport mesh
+  if (options->tally_nx) {
+    map_tally_mesh(global_nx, global_ny, options);
+  }
+
+  // Particles cross the facets inside uniform regions of the mesh without
+  // stopping, with the macro-cells also rebuilt after a rebalance
+  options->macro_cell_level = NULL;
+  if (options->macro_cells) {
+    options->macro_cell_level =
+        build_macro_cells(nx, ny, pad, x_off, y_off, density);
+  }
+
+  // The event-based sweeps batch their particles through the SIMD kernels of
+  // the widest instruction set the CPU supports
+  options->simd_lanes = 0;
+  if (options->simd_kernels && (options->transport_mode == EVENT_BASED ||
+                                options->transport_mode == HYBRID_BASED)) {
+    options->simd_lanes = select_simd_kernels();
+  }
+
+  // The lookup benchmark only runs before the first timestep
+  if (options->cs_benchmark) {
+    benchmark_cs_lookup(cs_scatter_table, options->cs_benchmark);
+    options->cs_benchmark = 0;
+  }
+
+  // Delta tracking samples flights against the largest density on the rank,
+  // and otherwise particles are tracked from facet to facet
+  options->majorant_density = 0.0;
+  if (options->transport_mode == DELTA_BASED) {
+    options->majorant_density =
+        calculate_majorant_density(nx, ny, pad, density);
+  }
+
+  // Sorting changes which random number stream each particle is keyed with,
+  // so results only match the unsorted run statistically
+  if (*nparticles && options->particle_sort != NO_SORT) {
+    const double sort_start = omp_get_wtime();
+    START_PROFILING(&compute_profile);
+    sort_particles(nx, ny, x_off, y_off, options->particle_sort, *nparticles,
+                   particles);
+    STOP_PROFILING(&compute_profile, "sort particles");
+    printf("Sort time  %.4fs\n", omp_get_wtime() - sort_start);
+  }
 
+  // Contributions are buffered per thread and reduced after the timestep,
+  // with reproducible tallies also rounding each contribution
+  if (options->tally_mode == PRIVATE_TALLY ||
+      options->tally_mode == REPRODUCIBLE_TALLY) {
+    initialise_tally_buffers();
+  }
+
+  // The bank was allocated with room for twice the particles
+  initialise_particle_exchange(2 * ntotal_particles);
+
+  const int tally_ncells =
+      (options->tally_nx) ? options->tally_nx * options->tally_ny : nx * ny;
+
+  // Ranks without particles still take part in the exchange of particles
+  // with their neighbours
+  int ntracked = *nparticles;
   if (!(*nparticles)) {
     printf("Out of particles\n");
-    return;
+  } else if (options->transport_mode == TILED_BASED) {
+    handle_particles_tiled(
+        global_nx, global_ny, nx, ny, master_key, pad, x_off, y_off, 1, dt,
+        neighbours, density, edgex, edgey, facet_events, collision_events,
+        ntotal_particles, *nparticles, particles, cs_scatter_table,
+        cs_absorb_table, energy_deposition_tally, scalar_flux_tally, options);
+  } else if (options->transport_mode == HYBRID_BASED) {
+    handle_particles_hybrid(
+        global_nx, global_ny, nx, ny, master_key, pad, x_off, y_off, 1, dt,
+        neighbours, density, edgex, edgey, facet_events, collision_events,
+        ntotal_particles, *nparticles, particles, cs_scatter_table,
+        cs_absorb_table, energy_deposition_tally, scalar_flux_tally, options);
+  } else if (options->transport_mode == EVENT_BASED) {
+    handle_particles_event_based(
+        global_nx, global_ny, nx, ny, master_key, pad, x_off, y_off, 1, dt,
+        neighbours, density, edgex, edgey, facet_events, collision_events,
+        ntotal_particles, *nparticles, particles, cs_scatter_table,
+        cs_absorb_table, energy_deposition_tally, scalar_flux_tally, options);
+  } else if (options->scheduler == WORK_STEALING_SCHEDULER) {
+    handle_particles_work_stealing(
+        global_nx, global_ny, nx, ny, master_key, pad, x_off, y_off, 1, dt,
+        neighbours, density, edgex, edgey, facet_events, collision_events,
+        ntotal_particles, *nparticles, particles, cs_scatter_table,
+        cs_absorb_table, energy_deposition_tally, scalar_flux_tally, options);
+  } else if (options->bank) {
+    // The validated layout also tracks the full-precision bank, which only
+    // differs by the rounding of the compact bank
+    if (options->compact_layout == VALIDATED_COMPACT_LAYOUT) {
+      track_full_precision_bank(
+          global_nx, global_ny, nx, ny, master_key, pad, x_off, y_off, dt,
+          neighbours, density, edgex, edgey, edgedx, edgedy, ntotal_particles,
+          *nparticles, particles, cs_scatter_table, cs_absorb_table,
+          tally_ncells, energy_deposition_tally, scalar_flux_tally, options);
+    }
+    handle_bank_particles(
+        global_nx, global_ny, nx, ny, master_key, pad, x_off, y_off, 1, dt,
+        neighbours, density, edgex, edgey, facet_events, collision_events,
+        ntotal_particles, *nparticles, options->bank, cs_scatter_table,
+        cs_absorb_table, energy_deposition_tally, scalar_flux_tally, options);
+  } else if (!has_neighbouring_ranks(neighbours)) {
+    handle_particles(global_nx, global_ny, nx, ny, master_key, pad, x_off,
+                     y_off, 1, dt, neighbours, density, edgex, edgey, edgedx,
+                     edgedy, facet_events, collision_events, ntotal_particles,
+                     *nparticles, particles, cs_scatter_table, cs_absorb_table,
+                     energy_deposition_tally, scalar_flux_tally, options);
+  } else {
+    // Tracked in blocks that overlap with the exchange of particles
+    ntracked = 0;
+  }
+
+  migrate_particles(global_nx, global_ny, nx, ny, master_key, pad, x_off,
+                    y_off, dt, neighbours, density, edgex, edgey, facet_events,
+                    collision_events, ntotal_particles, ntracked, nparticles,
+                    particles, cs_scatter_table, cs_absorb_table,
+                    energy_deposition_tally, scalar_flux_tally, options);
+
+  if (options->tally_mode != ATOMIC_TALLY) {
+    START_PROFILING(&compute_profile);
+    reduce_tally_buffers(energy_deposition_tally, scalar_flux_tally);
+    STOP_PROFILING(&compute_profile, "reduce tallies");
   }
 
-  handle_particles(global_nx, global_ny, nx, ny, master_key, pad, x_off, y_off,
-                   1, dt, neighbours, density, edgex, edgey, edgedx, edgedy,
-                   facet_events, collision_events, ntotal_particles,
-                   *nparticles, particles, cs_scatter_table, cs_absorb_table,
-                   energy_deposition_tally);
+  if (*nparticles && options->bank &&
+      options->compact_layout == VALIDATED_COMPACT_LAYOUT) {
+    compare_compact_layout(tally_ncells, energy_deposition_tally);
+  }
 }
 
 // Handles the current active batch of particles
@@ -51,7 +181,9 @@ void handle_particles(const int global_nx, const int global_ny, const int nx,
                       const int nparticles_to_process,
                       Particle* particles_start, CrossSection* cs_scatter_table,
                       CrossSection* cs_absorb_table,
-                      double* energy_deposition_tally) {
+                      double* energy_deposition_tally,
+                      double* scalar_flux_tally,
+                      const TransportOptions* options) {
 
   int nthreads = 0;
 #pragma omp parallel
@@ -73,8 +205,6 @@ void handle_particles(const int global_nx, const int global_ny, const int nx,
     const int rem = (tid < np_remainder);
     const int particles_off = tid * np_per_thread + min(tid, np_remainder);
 
-    int result = PARTICLE_CONTINUE;
-
     for (int pp = 0; pp < np_per_thread + rem; ++pp) {
       // (1) particle can stream and reach census
       // (2) particle can collide and either
@@ -86,115 +216,17 @@ void handle_particles(const int global_nx, const int global_ny, const int nx,
       const int pid = particles_off + pp;
       Particle* particle = &particles_start[pid];
 
-      const uint64_t pkey = pid;
-
       if (particle->dead) {
         continue;
       }
 
       nparticles++;
 
-      int x_facet = 0;
-      int absorb_cs_index = -1;
-      int scatter_cs_index = -1;
-      double cell_mfp = 0.0;
-
-      // Determine the current cell
-      int cellx = particle->cellx - x_off + pad;
-      int celly = particle->celly - y_off + pad;
-      double local_density = density[celly * (nx + 2 * pad) + cellx];
-
-      // Fetch the cross sections and prepare related quantities
-      double microscopic_cs_scatter = microscopic_cs_for_energy(
-          cs_scatter_table, particle->energy, &scatter_cs_index);
-      double microscopic_cs_absorb = microscopic_cs_for_energy(
-          cs_absorb_table, particle->energy, &absorb_cs_index);
-      double number_density = (local_density * AVOGADROS / MOLAR_MASS);
-      double macroscopic_cs_scatter =
-          number_density * microscopic_cs_scatter * BARNS;
-      double macroscopic_cs_absorb =
-          number_density * microscopic_cs_absorb * BARNS;
-      double speed = sqrt((2.0 * particle->energy * eV_TO_J) / PARTICLE_MASS);
-      double energy_deposition = 0.0;
-
-      const double inv_ntotal_particles = 1.0 / (double)ntotal_particles;
-
-      uint64_t counter = 0;
-      double rn[NRANDOM_NUMBERS];
-
-      // Set time to census and MFPs until collision, unless travelled
-      // particle
-      if (initial) {
-        particle->dt_to_census = dt;
-        generate_random_numbers(pkey, master_key, counter++, &rn[0], &rn[1]);
-        particle->mfp_to_collision = -log(rn[0]) / macroscopic_cs_scatter;
-      }
-
-      // Loop until we have reached census
-      while (particle->dt_to_census > 0.0) {
-        cell_mfp = 1.0 / (macroscopic_cs_scatter + macroscopic_cs_absorb);
-
-        // Work out the distance until the particle hits a facet
-        double distance_to_facet = 0.0;
-        calc_distance_to_facet(global_nx, particle->x, particle->y, pad, x_off,
-                               y_off, particle->omega_x, particle->omega_y,
-                               speed, particle->cellx, particle->celly,
-                               &distance_to_facet, &x_facet, edgex, edgey);
-
-        const double distance_to_collision =
-            particle->mfp_to_collision * cell_mfp;
-        const double distance_to_census = speed * particle->dt_to_census;
-
-        // Check if our next event is a collision
-        if (distance_to_collision < distance_to_facet &&
-            distance_to_collision < distance_to_census) {
-
-          // Track the total number of collisions
-          ncollisions++;
-
-          // Handles a collision event
-          result = collision_event(
-              global_nx, nx, x_off, y_off, pid, master_key,
-              inv_ntotal_particles, distance_to_collision, local_density,
-              cs_scatter_table, cs_absorb_table, particle, &counter,
-              &energy_deposition, &number_density, &microscopic_cs_scatter,
-              &microscopic_cs_absorb, &macroscopic_cs_scatter,
-              &macroscopic_cs_absorb, energy_deposition_tally,
-              &scatter_cs_index, &absorb_cs_index, rn, &speed);
-
-          if (result != PARTICLE_CONTINUE) {
-            break;
-          }
-        }
-        // Check if we have reached facet
-        else if (distance_to_facet < distance_to_census) {
-
-          // Track the number of fact encounters
-          nfacets++;
-
-          result = facet_event(
-              global_nx, global_ny, nx, ny, x_off, y_off, inv_ntotal_particles,
-              distance_to_facet, speed, cell_mfp, x_facet, density, neighbours,
-              particle, &energy_deposition, &number_density,
-              &microscopic_cs_scatter, &microscopic_cs_absorb,
-              &macroscopic_cs_scatter, &macroscopic_cs_absorb,
-              energy_deposition_tally, &cellx, &celly, &local_density);
-
-          if (result != PARTICLE_CONTINUE) {
-            break;
-          }
-
-        } else {
-
-          census_event(global_nx, nx, x_off, y_off, inv_ntotal_particles,
-                       distance_to_census, cell_mfp, particle,
-                       &energy_deposition, &number_density,
-                       &microscopic_cs_scatter, &microscopic_cs_absorb,
-                       energy_deposition_tally);
-
-          break;
-        }
-      }
+      handle_particle(global_nx, global_ny, nx, ny, master_key, pad, x_off,
+                      y_off, initial, dt, pid, neighbours, density, edgex,
+                      edgey, ntotal_particles, particle, cs_scatter_table,
+                      cs_absorb_table, energy_deposition_tally,
+                      scalar_flux_tally, &nfacets, &ncollisions, options);
     }
   }
 
@@ -205,24 +237,303 @@ void handle_particles(const int global_nx, const int global_ny, const int nx,
   printf("Particles  %llu\n", nparticles);
 }
 
+// Prepares the state of a single particle and tracks its history to census
+inline void handle_particle(
+    const int global_nx, const int global_ny, const int nx, const int ny,
+    const uint64_t master_key, const int pad, const int x_off, const int y_off,
+    const int initial, const double dt, const int pid, const int* neighbours,
+    const double* density, const double* edgex, const double* edgey,
+    const int ntotal_particles, Particle* particle,
+    CrossSection* cs_scatter_table, CrossSection* cs_absorb_table,
+    double* energy_deposition_tally, double* scalar_flux_tally,
+    uint64_t* nfacets, uint64_t* ncollisions, const TransportOptions* options) {
+
+  const uint64_t pkey = options->particle_key_offset + pid;
+
+  // The entries of the particle's last lookups start the search
+  int absorb_cs_index = particle->absorb_cs_index;
+  int scatter_cs_index = particle->scatter_cs_index;
+
+  // Determine the current cell
+  const int cellx = particle->cellx - x_off + pad;
+  const int celly = particle->celly - y_off + pad;
+  double local_density;
+  double number_density;
+  cell_densities(density, celly * (nx + 2 * pad) + cellx, &local_density,
+                 &number_density, options);
+
+  // Fetch the cross sections and prepare related quantities
+  double microscopic_cs_scatter;
+  double microscopic_cs_absorb;
+  microscopic_cs_for_reactions(cs_scatter_table, cs_absorb_table,
+                               particle->energy, &scatter_cs_index,
+                               &absorb_cs_index, &microscopic_cs_scatter,
+                               &microscopic_cs_absorb, options);
+  double macroscopic_cs_scatter =
+      number_density * microscopic_cs_scatter * BARNS;
+  double macroscopic_cs_absorb = number_density * microscopic_cs_absorb * BARNS;
+  double speed = sqrt((2.0 * particle->energy * eV_TO_J) / PARTICLE_MASS);
+  double energy_deposition = 0.0;
+  double scalar_flux = 0.0;
+
+  const double inv_ntotal_particles = 1.0 / (double)ntotal_particles;
+
+  uint64_t counter = 0;
+
+  // Set time to census and MFPs until collision, unless travelled
+  // particle
+  if (initial) {
+    double rn[NRANDOM_NUMBERS];
+    particle->dt_to_census = dt;
+    generate_random_numbers(pkey, master_key, counter++, &rn[0], &rn[1]);
+    particle->mfp_to_collision = -log(rn[0]) / macroscopic_cs_scatter;
+  }
+
+  // Loop until we have reached census
+  int result;
+  // History-based tracking can follow the problem regions the density was
+  // rasterized from, stopping only at their borders
+  if (options->problem_regions) {
+    result = track_particle_csg(
+        global_nx, global_ny, nx, ny, master_key, pad, x_off, y_off,
+        inv_ntotal_particles, pid, edgex, edgey, particle, cs_scatter_table,
+        cs_absorb_table, energy_deposition_tally, scalar_flux_tally, &counter,
+        &local_density, &energy_deposition, &scalar_flux, &number_density,
+        &microscopic_cs_scatter, &microscopic_cs_absorb,
+        &macroscopic_cs_scatter, &macroscopic_cs_absorb, &scatter_cs_index,
+        &absorb_cs_index, &speed, nfacets, ncollisions, options);
+  } else if (options->majorant_density > 0.0) {
+    result = track_particle_delta(
+        global_nx, global_ny, nx, ny, master_key, pad, x_off, y_off,
+        inv_ntotal_particles, pid, density, edgex, edgey, particle,
+        cs_scatter_table, cs_absorb_table, energy_deposition_tally,
+        scalar_flux_tally, &counter, &local_density, &energy_deposition,
+        &scalar_flux, &number_density, &microscopic_cs_scatter,
+        &microscopic_cs_absorb, &macroscopic_cs_scatter, &macroscopic_cs_absorb,
+        &scatter_cs_index, &absorb_cs_index, &speed, nfacets, ncollisions,
+        options);
+  } else {
+    result = track_particle_history(
+        global_nx, global_ny, nx, ny, master_key, pad, x_off, y_off,
+        inv_ntotal_particles, pid, 0, 0, global_nx, global_ny, neighbours,
+        density, edgex, edgey, particle, cs_scatter_table, cs_absorb_table,
+        energy_deposition_tally, scalar_flux_tally, &counter, &local_density,
+        &energy_deposition, &scalar_flux, &number_density,
+        &microscopic_cs_scatter, &microscopic_cs_absorb,
+        &macroscopic_cs_scatter, &macroscopic_cs_absorb, &scatter_cs_index,
+        &absorb_cs_index, &speed, nfacets, ncollisions, options);
+  }
+
+  particle->scatter_cs_index = scatter_cs_index;
+  particle->absorb_cs_index = absorb_cs_index;
+
+  // The particle has crossed into the domain of a neighbouring rank
+  if (result == PARTICLE_SENT) {
+    send_and_mark_particle(pid, particle);
+  }
+}
+
+// Tracks a particle history from its current state until it reaches census,
+// is absorbed, or leaves the tile of cells [tile_x0, tile_x1) x [tile_y0,
+// tile_y1)
+inline int track_particle_history(
+    const int global_nx, const int global_ny, const int nx, const int ny,
+    const uint64_t master_key, const int pad, const int x_off, const int y_off,
+    const double inv_ntotal_particles, const uint64_t pid, const int tile_x0,
+    const int tile_y0, const int tile_x1, const int tile_y1,
+    const int* neighbours, const double* density, const double* edgex,
+    const double* edgey, Particle* particle, CrossSection* cs_scatter_table,
+    CrossSection* cs_absorb_table, double* energy_deposition_tally,
+    double* scalar_flux_tally, uint64_t* counter, double* local_density,
+    double* energy_deposition, double* scalar_flux, double* number_density,
+    double* microscopic_cs_scatter, double* microscopic_cs_absorb,
+    double* macroscopic_cs_scatter, double* macroscopic_cs_absorb,
+    int* scatter_cs_index, int* absorb_cs_index, double* speed,
+    uint64_t* nfacets, uint64_t* ncollisions, const TransportOptions* options) {
+
+  int x_facet = 0;
+  int cellx = 0;
+  int celly = 0;
+  double cell_mfp = 0.0;
+  double rn[NRANDOM_NUMBERS];
+
+  // Along a direction the particle steps from facet to facet with the
+  // distances to the next x and y facets, which shrink by the distance moved
+  // and grow by the width of each cell entered times the facet scale, so they
+  // are only found from the edges when the direction changes. Until an event
+  // may reach a facet, the distance to the nearest facet in any direction
+  // shows that they are not needed at all.
+  double safety_distance = 0.0;
+  double distance_to_x_facet = 0.0;
+  double distance_to_y_facet = 0.0;
+  double x_facet_scale = 0.0;
+  double y_facet_scale = 0.0;
+  int safety_found = 0;
+  int facets_found = 0;
+
+  while (particle->dt_to_census > 0.0) {
+    cell_mfp = 1.0 / (*macroscopic_cs_scatter + *macroscopic_cs_absorb);
+
+    const double distance_to_collision = particle->mfp_to_collision * cell_mfp;
+    const double distance_to_census = *speed * particle->dt_to_census;
+
+    if (!facets_found) {
+      if (!safety_found) {
+        safety_distance = calc_safety_distance(
+            particle->x, particle->y, pad, x_off, y_off, particle->cellx,
+            particle->celly, edgex, edgey);
+        safety_found = 1;
+      }
+      if (min(distance_to_collision, distance_to_census) >= safety_distance) {
+        start_facet_traversal(particle->x, particle->y, pad, x_off, y_off,
+                              particle->omega_x, particle->omega_y,
+                              particle->cellx, particle->celly, edgex, edgey,
+                              &distance_to_x_facet, &distance_to_y_facet,
+                              &x_facet_scale, &y_facet_scale);
+        facets_found = 1;
+      }
+    }
+
+    // Work out the distance until the particle hits a facet, which is out of
+    // reach while the next event lies within the safety distance
+    double distance_to_facet = DBL_MAX;
+    if (facets_found) {
+      x_facet = (distance_to_x_facet < distance_to_y_facet) ? 1 : 0;
+      distance_to_facet = (x_facet) ? distance_to_x_facet : distance_to_y_facet;
+    }
+
+    // Facets inside the particle's uniform macro-cell are crossed in one step
+    // when they come before the next collision and census
+    if (options->macro_cell_level &&
+        distance_to_facet <= distance_to_collision &&
+        distance_to_facet < distance_to_census) {
+      const double distance = cross_macro_cell(
+          global_nx, nx, ny, pad, x_off, y_off, tile_x0, tile_y0, tile_x1,
+          tile_y1, inv_ntotal_particles, distance_to_collision,
+          distance_to_census, cell_mfp, *speed, edgex, edgey, x_facet_scale,
+          y_facet_scale, particle, &distance_to_x_facet, &distance_to_y_facet,
+          energy_deposition, scalar_flux, *number_density,
+          *microscopic_cs_scatter, *microscopic_cs_absorb,
+          energy_deposition_tally, scalar_flux_tally, nfacets, options);
+      if (distance > 0.0) {
+        safety_found = 0;
+        continue;
+      }
+    }
+
+    // Check if our next event is a collision
+    if (distance_to_collision < distance_to_facet &&
+        distance_to_collision < distance_to_census) {
+
+      // Track the total number of collisions
+      (*ncollisions)++;
+
+      const double omega_x = particle->omega_x;
+      const double omega_y = particle->omega_y;
+
+      // Handles a collision event
+      const int result = collision_event(
+          global_nx, nx, x_off, y_off, options->particle_key_offset + pid,
+          master_key, inv_ntotal_particles, distance_to_collision,
+          cs_scatter_table, cs_absorb_table, particle, counter,
+          energy_deposition, scalar_flux, number_density,
+          microscopic_cs_scatter, microscopic_cs_absorb,
+          macroscopic_cs_scatter, macroscopic_cs_absorb,
+          energy_deposition_tally, scalar_flux_tally, scatter_cs_index,
+          absorb_cs_index, rn, speed, options);
+
+      if (result != PARTICLE_CONTINUE) {
+        return result;
+      }
+
+      safety_distance -= distance_to_collision;
+      distance_to_x_facet -= distance_to_collision;
+      distance_to_y_facet -= distance_to_collision;
+
+      // Only a scatter turns the particle
+      if (particle->omega_x != omega_x || particle->omega_y != omega_y) {
+        facets_found = 0;
+      }
+    }
+    // Check if we have reached facet
+    else if (distance_to_facet < distance_to_census) {
+
+      // Track the number of fact encounters
+      (*nfacets)++;
+
+      const int facet_cellx = particle->cellx;
+      const int facet_celly = particle->celly;
+
+      const int result = facet_event(
+          global_nx, global_ny, nx, ny, x_off, y_off, inv_ntotal_particles,
+          distance_to_facet, *speed, cell_mfp, x_facet, density, neighbours,
+          particle, energy_deposition, scalar_flux, number_density,
+          microscopic_cs_scatter, microscopic_cs_absorb, macroscopic_cs_scatter,
+          macroscopic_cs_absorb, energy_deposition_tally, scalar_flux_tally,
+          &cellx, &celly, local_density, options);
+
+      if (result != PARTICLE_CONTINUE) {
+        return result;
+      }
+
+      // The next facet along the crossed axis is the far side of the new cell,
+      // and a reflection at the problem boundary turns the particle
+      safety_found = 0;
+      if (particle->cellx != facet_cellx) {
+        const int c = particle->cellx - x_off + pad;
+        distance_to_x_facet = (edgex[c + 1] - edgex[c]) * x_facet_scale;
+        distance_to_y_facet -= distance_to_facet;
+      } else if (particle->celly != facet_celly) {
+        const int c = particle->celly - y_off + pad;
+        distance_to_y_facet = (edgey[c + 1] - edgey[c]) * y_facet_scale;
+        distance_to_x_facet -= distance_to_facet;
+      } else {
+        facets_found = 0;
+      }
+
+      // The particle is handed off when it crosses into another tile
+      if (particle->cellx < tile_x0 || particle->cellx >= tile_x1 ||
+          particle->celly < tile_y0 || particle->celly >= tile_y1) {
+        return PARTICLE_SENT;
+      }
+
+    } else {
+
+      census_event(global_nx, nx, x_off, y_off, inv_ntotal_particles,
+                   distance_to_census, cell_mfp, particle, energy_deposition,
+                   scalar_flux, number_density, microscopic_cs_scatter,
+                   microscopic_cs_absorb, energy_deposition_tally,
+                   scalar_flux_tally, options);
+
+      return PARTICLE_CENSUS;
+    }
+  }
+
+  return PARTICLE_CENSUS;
+}
+
 // Handles a collision event
 inline int collision_event(
     const int global_nx, const int nx, const int x_off, const int y_off,
     const uint64_t pkey, const uint64_t master_key,
     const double inv_ntotal_particles, const double distance_to_collision,
-    const double local_density, const CrossSection* cs_scatter_table,
-    const CrossSection* cs_absorb_table, Particle* particle, uint64_t* counter,
-    double* energy_deposition, double* number_density,
+    const CrossSection* cs_scatter_table, const CrossSection* cs_absorb_table,
+    Particle* particle, uint64_t* counter, double* energy_deposition,
+    double* scalar_flux, double* number_density,
     double* microscopic_cs_scatter, double* microscopic_cs_absorb,
     double* macroscopic_cs_scatter, double* macroscopic_cs_absorb,
-    double* energy_deposition_tally, int* scatter_cs_index,
-    int* absorb_cs_index, double rn[NRANDOM_NUMBERS], double* speed) {
+    double* energy_deposition_tally, double* scalar_flux_tally,
+    int* scatter_cs_index, int* absorb_cs_index, double rn[NRANDOM_NUMBERS],
+    double* speed, const TransportOptions* options) {
 
   // Energy deposition stored locally for collision, not in tally mesh
   *energy_deposition += calculate_energy_deposition(
       global_nx, nx, x_off, y_off, particle, inv_ntotal_particles,
       distance_to_collision, *number_density, *microscopic_cs_absorb,
       *microscopic_cs_scatter + *microscopic_cs_absorb);
+  if (scalar_flux_tally) {
+    *scalar_flux += particle->weight * distance_to_collision;
+  }
 
   // Moves the particle to the collision site
   particle->x += distance_to_collision * particle->omega_x;
@@ -246,8 +557,10 @@ inline int collision_event(
 
       // Need to store tally information as finished with particle
       update_tallies(nx, x_off, y_off, particle, inv_ntotal_particles,
-                     *energy_deposition, energy_deposition_tally);
+                     *energy_deposition, *scalar_flux, energy_deposition_tally,
+                     scalar_flux_tally, options);
       *energy_deposition = 0.0;
+      *scalar_flux = 0.0;
       return PARTICLE_DEAD;
     }
   } else {
@@ -282,11 +595,10 @@ inline int collision_event(
   }
 
   // Energy has changed so update the cross-sections
-  *microscopic_cs_scatter = microscopic_cs_for_energy(
-      cs_scatter_table, particle->energy, scatter_cs_index);
-  *microscopic_cs_absorb = microscopic_cs_for_energy(
-      cs_absorb_table, particle->energy, absorb_cs_index);
-  *number_density = (local_density * AVOGADROS / MOLAR_MASS);
+  microscopic_cs_for_reactions(cs_scatter_table, cs_absorb_table,
+                               particle->energy, scatter_cs_index,
+                               absorb_cs_index, microscopic_cs_scatter,
+                               microscopic_cs_absorb, options);
   *macroscopic_cs_scatter = *number_density * (*microscopic_cs_scatter) * BARNS;
   *macroscopic_cs_absorb = *number_density * (*microscopic_cs_absorb) * BARNS;
 
@@ -306,11 +618,12 @@ facet_event(const int global_nx, const int global_ny, const int nx,
             const double inv_ntotal_particles, const double distance_to_facet,
             const double speed, const double cell_mfp, const int x_facet,
             const double* density, const int* neighbours, Particle* particle,
-            double* energy_deposition, double* number_density,
-            double* microscopic_cs_scatter, double* microscopic_cs_absorb,
-            double* macroscopic_cs_scatter, double* macroscopic_cs_absorb,
-            double* energy_deposition_tally, int* cellx, int* celly,
-            double* local_density) {
+            double* energy_deposition, double* scalar_flux,
+            double* number_density, double* microscopic_cs_scatter,
+            double* microscopic_cs_absorb, double* macroscopic_cs_scatter,
+            double* macroscopic_cs_absorb, double* energy_deposition_tally,
+            double* scalar_flux_tally, int* cellx, int* celly,
+            double* local_density, const TransportOptions* options) {
 
   // Update the mean free paths until collision
   particle->mfp_to_collision -= (distance_to_facet / cell_mfp);
@@ -320,16 +633,16 @@ facet_event(const int global_nx, const int global_ny, const int nx,
       global_nx, nx, x_off, y_off, particle, inv_ntotal_particles,
       distance_to_facet, *number_density, *microscopic_cs_absorb,
       *microscopic_cs_scatter + *microscopic_cs_absorb);
-
-  // Update tallies as we leave a cell
-  update_tallies(nx, x_off, y_off, particle, inv_ntotal_particles,
-                 *energy_deposition, energy_deposition_tally);
-  *energy_deposition = 0.0;
+  if (scalar_flux_tally) {
+    *scalar_flux += particle->weight * distance_to_facet;
+  }
 
   // Move the particle to the facet
   particle->x += distance_to_facet * particle->omega_x;
   particle->y += distance_to_facet * particle->omega_y;
 
+  int next_cellx = particle->cellx;
+  int next_celly = particle->celly;
   if (x_facet) {
     if (particle->omega_x > 0.0) {
       // Reflect at the boundary
@@ -337,7 +650,7 @@ facet_event(const int global_nx, const int global_ny, const int nx,
         particle->omega_x = -(particle->omega_x);
       } else {
         // Moving to right cell
-        particle->cellx++;
+        next_cellx++;
       }
     } else if (particle->omega_x < 0.0) {
       if (particle->cellx <= 0) {
@@ -345,7 +658,7 @@ facet_event(const int global_nx, const int global_ny, const int nx,
         particle->omega_x = -(particle->omega_x);
       } else {
         // Moving to left cell
-        particle->cellx--;
+        next_cellx--;
       }
     }
   } else {
@@ -355,7 +668,7 @@ facet_event(const int global_nx, const int global_ny, const int nx,
         particle->omega_y = -(particle->omega_y);
       } else {
         // Moving to north cell
-        particle->celly++;
+        next_celly++;
       }
     } else if (particle->omega_y < 0.0) {
       // Reflect at the boundary
@@ -363,16 +676,36 @@ facet_event(const int global_nx, const int global_ny, const int nx,
         particle->omega_y = -(particle->omega_y);
       } else {
         // Moving to south cell
-        particle->celly--;
+        next_celly--;
       }
     }
   }
 
+  // Update tallies as we leave a tally cell or the rank, so the contributions
+  // of the cells inside a coarse tally cell are gathered together
+  const int leaves_rank = (next_cellx < x_off || next_cellx >= x_off + nx ||
+                           next_celly < y_off || next_celly >= y_off + ny);
+  if (leaves_rank || enters_tally_cell(particle->cellx, particle->celly,
+                                       next_cellx, next_celly, options)) {
+    update_tallies(nx, x_off, y_off, particle, inv_ntotal_particles,
+                   *energy_deposition, *scalar_flux, energy_deposition_tally,
+                   scalar_flux_tally, options);
+    *energy_deposition = 0.0;
+    *scalar_flux = 0.0;
+  }
+  particle->cellx = next_cellx;
+  particle->celly = next_celly;
+
+  // The particle has left the rank, and is resumed by the neighbour
+  if (leaves_rank) {
+    return PARTICLE_SENT;
+  }
+
   // Update the data based on new cell
   *cellx = particle->cellx - x_off;
   *celly = particle->celly - y_off;
-  *local_density = density[*celly * nx + *cellx];
-  *number_density = (*local_density * AVOGADROS / MOLAR_MASS);
+  cell_densities(density, *celly * nx + *cellx, local_density,
+                 number_density, options);
   *macroscopic_cs_scatter = *number_density * *microscopic_cs_scatter * BARNS;
   *macroscopic_cs_absorb = *number_density * *microscopic_cs_absorb * BARNS;
 
@@ -385,8 +718,10 @@ census_event(const int global_nx, const int nx, const int x_off,
              const int y_off, const double inv_ntotal_particles,
              const double distance_to_census, const double cell_mfp,
              Particle* particle, double* energy_deposition,
-             double* number_density, double* microscopic_cs_scatter,
-             double* microscopic_cs_absorb, double* energy_deposition_tally) {
+             double* scalar_flux, double* number_density,
+             double* microscopic_cs_scatter, double* microscopic_cs_absorb,
+             double* energy_deposition_tally, double* scalar_flux_tally,
+             const TransportOptions* options) {
 
   // We have not changed cell or energy level at this stage
   particle->x += distance_to_census * particle->omega_x;
@@ -396,27 +731,72 @@ census_event(const int global_nx, const int nx, const int x_off,
       global_nx, nx, x_off, y_off, particle, inv_ntotal_particles,
       distance_to_census, *number_density, *microscopic_cs_absorb,
       *microscopic_cs_scatter + *microscopic_cs_absorb);
+  if (scalar_flux_tally) {
+    *scalar_flux += particle->weight * distance_to_census;
+  }
 
   // Need to store tally information as finished with particle
   update_tallies(nx, x_off, y_off, particle, inv_ntotal_particles,
-                 *energy_deposition, energy_deposition_tally);
+                 *energy_deposition, *scalar_flux, energy_deposition_tally,
+                 scalar_flux_tally, options);
 
   particle->dt_to_census = 0.0;
 }
 
-// Tallies the energy deposition in the cell
+// Tallies the energy deposition and scalar flux in the particle's tally cell
 inline void update_tallies(const int nx, const int x_off,
                                   const int y_off, Particle* particle,
                                   const double inv_ntotal_particles,
                                   const double energy_deposition,
-                                  double* energy_deposition_tally) {
+                                  const double scalar_flux,
+                                  double* energy_deposition_tally,
+                                  double* scalar_flux_tally,
+                                  const TransportOptions* options) {
+
+  // A coarse tally mesh gathers the contributions of blocks of cells
+  const int index =
+      (options->tally_cell_x)
+          ? options->tally_cell_y[particle->celly] * options->tally_nx +
+                options->tally_cell_x[particle->cellx]
+          : (particle->celly - y_off) * nx + (particle->cellx - x_off);
+
+  if (private_tally) {
+    double contribution = energy_deposition * inv_ntotal_particles;
+    double flux_contribution = scalar_flux * inv_ntotal_particles;
+
+    // Multiples of the unit are summed exactly, in any order
+    const double tally_unit = options->tally_unit;
+    const double flux_unit = options->flux_unit;
+    if (tally_unit > 0.0) {
+      contribution = nearbyint(contribution / tally_unit) * tally_unit;
+      flux_contribution = nearbyint(flux_contribution / flux_unit) * flux_unit;
+    }
 
-  const int cellx = particle->cellx - x_off;
-  const int celly = particle->celly - y_off;
+    add_to_tally_buffer(private_tally, index, contribution, flux_contribution,
+                        energy_deposition_tally, scalar_flux_tally);
+    return;
+  }
 
 #pragma omp atomic update
-  energy_deposition_tally[celly * nx + cellx] +=
-      energy_deposition * inv_ntotal_particles;
+  energy_deposition_tally[index] += energy_deposition * inv_ntotal_particles;
+
+  if (scalar_flux_tally) {
+#pragma omp atomic update
+    scalar_flux_tally[index] += scalar_flux * inv_ntotal_particles;
+  }
+}
+
+// Checks whether moving between two cells takes the particle into another
+// cell of the tally mesh
+inline int enters_tally_cell(const int cellx, const int celly,
+                             const int next_cellx, const int next_celly,
+                             const TransportOptions* options) {
+
+  if (options->tally_cell_x) {
+    return (options->tally_cell_x[cellx] != options->tally_cell_x[next_cellx] ||
+            options->tally_cell_y[celly] != options->tally_cell_y[next_celly]);
+  }
+  return (cellx != next_cellx || celly != next_celly);
 }
 
 // Calculate the distance to the next facet
@@ -424,50 +804,73 @@ inline void
 calc_distance_to_facet(const int global_nx, const double x, const double y,
                        const int pad, const int x_off, const int y_off,
                        const double omega_x, const double omega_y,
-                       const double speed, const int particle_cellx,
-                       const int particle_celly, double* distance_to_facet,
-                       int* x_facet, const double* edgex, const double* edgey) {
+                       const int particle_cellx, const int particle_celly,
+                       double* distance_to_facet, int* x_facet,
+                       const double* edgex, const double* edgey) {
 
-  // Check the master_key required to move the particle along a single axis
-  // If the velocity is positive then the top or right boundary will be hit
+  // If the direction is positive then the top or right boundary will be hit
   const int cellx = particle_cellx - x_off + pad;
   const int celly = particle_celly - y_off + pad;
-  double u_x_inv = 1.0 / (omega_x * speed);
-  double u_y_inv = 1.0 / (omega_y * speed);
 
   // The bound is open on the left and bottom so we have to correct for this
   // and required the movement to the facet to go slightly further than the edge
   // in the calculated values, using OPEN_BOUND_CORRECTION, which is the
   // smallest possible distance from the closed bound e.g. 1.0e-14.
-  double dt_x = (omega_x >= 0.0)
-                    ? ((edgex[cellx + 1]) - x) * u_x_inv
-                    : ((edgex[cellx] - OPEN_BOUND_CORRECTION) - x) * u_x_inv;
-  double dt_y = (omega_y >= 0.0)
-                    ? ((edgey[celly + 1]) - y) * u_y_inv
-                    : ((edgey[celly] - OPEN_BOUND_CORRECTION) - y) * u_y_inv;
-  *x_facet = (dt_x < dt_y) ? 1 : 0;
-
-  // Calculated the projection to be
-  // a = vector on first edge to be hit
-  // u = velocity vector
-
-  double mag_u0 = speed;
-
-  if (*x_facet) {
-    // We are centered on the origin, so the y component is 0 after travelling
-    // aint the x axis to the edge (ax, 0).(x, y)
-    *distance_to_facet =
-        (omega_x >= 0.0)
-            ? ((edgex[cellx + 1]) - x) * mag_u0 * u_x_inv
-            : ((edgex[cellx] - OPEN_BOUND_CORRECTION) - x) * mag_u0 * u_x_inv;
-  } else {
-    // We are centered on the origin, so the x component is 0 after travelling
-    // along the y axis to the edge (0, ay).(x, y)
-    *distance_to_facet =
-        (omega_y >= 0.0)
-            ? ((edgey[celly + 1]) - y) * mag_u0 * u_y_inv
-            : ((edgey[celly] - OPEN_BOUND_CORRECTION) - y) * mag_u0 * u_y_inv;
-  }
+  const double distance_x =
+      (omega_x >= 0.0) ? ((edgex[cellx + 1]) - x) / omega_x
+                       : ((edgex[cellx] - OPEN_BOUND_CORRECTION) - x) / omega_x;
+  const double distance_y =
+      (omega_y >= 0.0) ? ((edgey[celly + 1]) - y) / omega_y
+                       : ((edgey[celly] - OPEN_BOUND_CORRECTION) - y) / omega_y;
+
+  *x_facet = (distance_x < distance_y) ? 1 : 0;
+  *distance_to_facet = (*x_facet) ? distance_x : distance_y;
+}
+
+// Calculate the distances along the particle's direction to the next x and y
+// facets of its cell, and the scales converting the width of a cell into the
+// distance between its facets along the direction
+inline void start_facet_traversal(
+    const double x, const double y, const int pad, const int x_off,
+    const int y_off, const double omega_x, const double omega_y,
+    const int particle_cellx, const int particle_celly, const double* edgex,
+    const double* edgey, double* distance_to_x_facet,
+    double* distance_to_y_facet, double* x_facet_scale,
+    double* y_facet_scale) {
+
+  const int cellx = particle_cellx - x_off + pad;
+  const int celly = particle_celly - y_off + pad;
+  const double omega_x_inv = 1.0 / omega_x;
+  const double omega_y_inv = 1.0 / omega_y;
+
+  // The open bounds on the left and bottom are corrected for as in
+  // calc_distance_to_facet, and as every facet is offset by the same
+  // correction the distance between facets is still the width of the cell
+  *distance_to_x_facet =
+      (omega_x >= 0.0) ? ((edgex[cellx + 1]) - x) * omega_x_inv
+                       : ((edgex[cellx] - OPEN_BOUND_CORRECTION) - x) *
+                             omega_x_inv;
+  *distance_to_y_facet =
+      (omega_y >= 0.0) ? ((edgey[celly + 1]) - y) * omega_y_inv
+                       : ((edgey[celly] - OPEN_BOUND_CORRECTION) - y) *
+                             omega_y_inv;
+  *x_facet_scale = fabs(omega_x_inv);
+  *y_facet_scale = fabs(omega_y_inv);
+}
+
+// Calculate the distance to the nearest facet of the particle's cell in any
+// direction, less the correction for the open bounds
+inline double calc_safety_distance(const double x, const double y,
+                                   const int pad, const int x_off,
+                                   const int y_off, const int particle_cellx,
+                                   const int particle_celly,
+                                   const double* edgex, const double* edgey) {
+
+  const int cellx = particle_cellx - x_off + pad;
+  const int celly = particle_celly - y_off + pad;
+  const double safety_x = min(x - edgex[cellx], edgex[cellx + 1] - x);
+  const double safety_y = min(y - edgey[celly], edgey[celly + 1] - y);
+  return min(safety_x, safety_y) - OPEN_BOUND_CORRECTION;
 }
 
 // Calculate the energy deposition in the cell
@@ -494,13 +897,129 @@ inline double calculate_energy_deposition(
          heating_response * number_density;
 }
 
+// Fetches the density and number density of a cell, through the material map
+// when the mesh has one
+inline void cell_densities(const double* density, const int index,
+                           double* local_density, double* number_density,
+                           const TransportOptions* options) {
+
+  if (options->cell_material) {
+    const int material = options->cell_material[index];
+    *local_density = options->material_density[material];
+    *number_density = options->material_number_density[material];
+  } else {
+    *local_density = density[index];
+    *number_density = (*local_density * AVOGADROS / MOLAR_MASS);
+  }
+}
+
 // Fetch the cross section for a particular energy value
 inline double microscopic_cs_for_energy(const CrossSection* cs,
                                                const double energy,
                                                int* cs_index) {
 
+  const int ind = cs_entry(cs, energy, cs_index);
+
+  // Return the value linearly interpolated
+  return cs->values[ind] +
+         ((energy - cs->keys[ind]) / (cs->keys[ind + 1] - cs->keys[ind])) *
+             (cs->values[ind + 1] - cs->values[ind]);
+}
+
+// Fetch the scattering and absorption cross sections for a particular energy,
+// with a single search when the tables share a unionized grid
+inline void microscopic_cs_for_reactions(
+    const CrossSection* cs_scatter_table, const CrossSection* cs_absorb_table,
+    const double energy, int* scatter_cs_index, int* absorb_cs_index,
+    double* microscopic_cs_scatter, double* microscopic_cs_absorb,
+    const TransportOptions* options) {
+
+  if (options->unionized_table) {
+    double microscopic_cs[NREACTIONS];
+    microscopic_cs_unionized(options->unionized_table, energy,
+                             scatter_cs_index, microscopic_cs);
+    *absorb_cs_index = *scatter_cs_index;
+    *microscopic_cs_scatter = microscopic_cs[SCATTER_REACTION];
+    *microscopic_cs_absorb = microscopic_cs[ABSORB_REACTION];
+  } else {
+    *microscopic_cs_scatter =
+        microscopic_cs_for_energy(cs_scatter_table, energy, scatter_cs_index);
+    *microscopic_cs_absorb =
+        microscopic_cs_for_energy(cs_absorb_table, energy, absorb_cs_index);
+  }
+}
+
+// Fetch the cross section of every reaction of a unionized grid for a
+// particular energy, interpolated from the same interval
+inline void microscopic_cs_unionized(const CrossSection* cs,
+                                     const double energy, int* cs_index,
+                                     double* microscopic_cs) {
+
+  const int ind = cs_entry(cs, energy, cs_index);
+
+  const double fraction =
+      (energy - cs->keys[ind]) / (cs->keys[ind + 1] - cs->keys[ind]);
+  const double* lower = &cs->values[ind * cs->nreactions];
+  const double* upper = &cs->values[(ind + 1) * cs->nreactions];
+  for (int rr = 0; rr < cs->nreactions; ++rr) {
+    microscopic_cs[rr] = lower[rr] + fraction * (upper[rr] - lower[rr]);
+  }
+}
+
+// Finds the entry whose interval holds an energy, starting from the entry of
+// the particle's previous lookup when it has one
+inline int cs_entry(const CrossSection* cs, const double energy,
+                    int* cs_index) {
+
+  // Collisions only lower the energy, so the previous entry bounds the search
+  // from above, and a particle without one searches the whole table
+  int ind;
+  if (*cs_index >= 0 && energy < cs->keys[*cs_index + 1]) {
+    ind = cs_entry_galloping(cs, energy, *cs_index);
+  } else {
+    ind = (cs->nbins) ? cs_entry_hashed(cs, energy)
+                      : cs_entry_binary(cs, energy);
+  }
+
+  *cs_index = ind;
+  return ind;
+}
+
+// Finds the entry whose interval holds an energy below the upper key of the
+// hinted entry, galloping downwards in doubling steps and then bisecting
+inline int cs_entry_galloping(const CrossSection* cs, const double energy,
+                              const int hint) {
+
+  double* keys = cs->keys;
+
+  // An elastic scatter lowers the energy by at most a factor set by MASS_NO,
+  // so most searches end within the first few steps
+  int hi = hint;
+  int lo = hint;
+  int step = 1;
+  while (lo > 0 && energy < keys[lo]) {
+    hi = lo - 1;
+    lo = max(0, lo - step);
+    step *= 2;
+  }
+
+  // The entry is now in [lo, hi], the energy lying below keys[hi + 1]
+  while (lo < hi) {
+    const int mid = (lo + hi + 1) / 2;
+    if (energy < keys[mid]) {
+      hi = mid - 1;
+    } else {
+      lo = mid;
+    }
+  }
+
+  return lo;
+}
+
+// Finds the entry whose interval holds an energy by searching the whole table
+inline int cs_entry_binary(const CrossSection* cs, const double energy) {
+
   double* keys = cs->keys;
-  double* values = cs->values;
 
   // Use a simple binary search to find the energy group
   int ind = cs->nentries / 2;
@@ -510,10 +1029,38 @@ inline double microscopic_cs_for_energy(const CrossSection* cs,
     width = max(1, width / 2); // To handle odd cases, allows one extra walk
   }
 
-  // Return the value linearly interpolated
-  return values[ind] +
-         ((energy - keys[ind]) / (keys[ind + 1] - keys[ind])) *
-             (values[ind + 1] - values[ind]);
+  return ind;
+}
+
+// Finds the entry whose interval holds an energy by searching only the
+// entries of its bin in the log-energy hash grid
+inline int cs_entry_hashed(const CrossSection* cs, const double energy) {
+
+  double* keys = cs->keys;
+
+  int bin = (int)((log(energy) - cs->log_key_min) * cs->inv_bin_width);
+  bin = min(cs->nbins - 1, max(0, bin));
+  int lo = cs->bin_entries[bin];
+  int hi = cs->bin_entries[bin + 1];
+  while (lo < hi) {
+    const int mid = (lo + hi + 1) / 2;
+    if (energy < keys[mid]) {
+      hi = mid - 1;
+    } else {
+      lo = mid;
+    }
+  }
+
+  // Rounding in the bin calculation can land an energy at the edge of the
+  // neighbouring bin, which is one interval away
+  while (lo > 0 && energy < keys[lo]) {
+    lo--;
+  }
+  while (lo < cs->nentries - 2 && energy >= keys[lo + 1]) {
+    lo++;
+  }
+
+  return lo;
 }
 
 // Validates the results of the simulation
@@ -622,6 +1169,8 @@ size_t inject_particles(const int nparticles, const int global_nx,
     particle->dt_to_census = dt;
     particle->mfp_to_collision = 0.0;
     particle->dead = 0;
+    particle->scatter_cs_index = -1;
+    particle->absorb_cs_index = -1;
   }
 
   STOP_PROFILING(&compute_profile, "initialising particles");
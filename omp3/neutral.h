@@ -1,4 +1,90 @@
 #include "../neutral_interface.h"
+#include <omp.h>
+
+// The live fraction at which the auto-tuned hybrid switches before it has
+// measured the cost of history-based tracking
+#define HYBRID_INITIAL_FRACTION 0.01
+
+// The number of particles in each chunk handed out by the work-stealing
+// scheduler
+#define PARTICLE_CHUNK_SIZE 64
+
+// The maximum number of buckets used by the particle counting sort
+#define SORT_MAX_BUCKETS (1 << 16)
+
+// The number of slots in each thread's private tally buffer, a power of two
+#define TALLY_BUFFER_BITS 16
+#define TALLY_BUFFER_SIZE (1 << TALLY_BUFFER_BITS)
+
+// The number of particles held by each mailbox exchanged with a neighbour
+#define PARTICLE_MAILBOX_SIZE 4096
+
+// The number of particles tracked between polls of the mailboxes
+#define MIGRATION_BLOCK_SIZE (1 << 14)
+
+// The number of distinct densities the material map can hold in a byte
+#define MAX_MATERIALS 256
+
+// The types of event a particle can encounter during an event-based sweep
+enum { COLLISION_EVENT, FACET_EVENT, CENSUS_EVENT, NO_EVENT, NEVENT_TYPES };
+
+// A range of particle chunks owned by a thread, where the owner takes chunks
+// from the head and thieves take chunks from the tail
+typedef struct {
+  omp_lock_t lock;
+  int head;
+  int tail;
+  char padding[64]; // Keeps neighbouring deques off the same cache line
+
+} ChunkDeque;
+
+// A thread-private sparse buffer of tally contributions, stored as an open
+// addressed hash table keyed on the tally cell
+typedef struct {
+  int* cells;    // The cell held in each slot, -1 marks an empty slot
+  double* values;
+  double* flux_values;
+  int* used;     // The slots currently holding a cell
+  int nused;
+  uint64_t nflushes;
+
+} TallyBuffer;
+
+// The private tally buffer of each thread, NULL when tallying atomically
+extern TallyBuffer* private_tally;
+#pragma omp threadprivate(private_tally)
+
+// The particles that have left the rank during a round of tracking
+typedef struct {
+  int* pids; // The bank index of each particle that has left
+  int nsent;
+  int capacity;
+
+} ParticleExchange;
+
+// The particles waiting to be sent to the neighbouring ranks
+extern ParticleExchange particle_exchange;
+
+// Per-particle state that persists between the event-based kernels
+typedef struct {
+  double* local_density;
+  double* number_density;
+  double* microscopic_cs_scatter;
+  double* microscopic_cs_absorb;
+  double* macroscopic_cs_scatter;
+  double* macroscopic_cs_absorb;
+  double* speed;
+  double* energy_deposition;
+  double* scalar_flux;
+  double* cell_mfp;
+  double* distance_to_event;
+  uint64_t* counter;
+  int* scatter_cs_index;
+  int* absorb_cs_index;
+  int* x_facet;
+  int* event;
+
+} EventState;
 
 // Handles the current active batch of particles
 void handle_particles(const int global_nx, const int global_ny, const int nx,
@@ -12,7 +98,211 @@ void handle_particles(const int global_nx, const int global_ny, const int nx,
                       const int nparticles_to_process,
                       Particle* particles_start, CrossSection* cs_scatter_table,
                       CrossSection* cs_absorb_table,
-                      double* energy_deposition_tally);
+                      double* energy_deposition_tally,
+                      double* scalar_flux_tally,
+                      const TransportOptions* options);
+
+// Sorts the particles into cell order so that neighbouring histories share
+// the density, edge and tally cache lines
+void sort_particles(const int nx, const int ny, const int x_off,
+                    const int y_off, const int sort_mode,
+                    const int nparticles, Particle* particles);
+
+// Handles the current active batch of particles, balancing the load between
+// threads by stealing chunks of particles
+void handle_particles_work_stealing(
+    const int global_nx, const int global_ny, const int nx, const int ny,
+    const uint64_t master_key, const int pad, const int x_off, const int y_off,
+    const int initial, const double dt, const int* neighbours,
+    const double* density, const double* edgex, const double* edgey,
+    uint64_t* facets, uint64_t* collisions, const int ntotal_particles,
+    const int nparticles_to_process, Particle* particles,
+    CrossSection* cs_scatter_table, CrossSection* cs_absorb_table,
+    double* energy_deposition_tally, double* scalar_flux_tally,
+    const TransportOptions* options);
+
+// Prepares the state of a single particle and tracks its history to census
+void handle_particle(
+    const int global_nx, const int global_ny, const int nx, const int ny,
+    const uint64_t master_key, const int pad, const int x_off, const int y_off,
+    const int initial, const double dt, const int pid, const int* neighbours,
+    const double* density, const double* edgex, const double* edgey,
+    const int ntotal_particles, Particle* particle,
+    CrossSection* cs_scatter_table, CrossSection* cs_absorb_table,
+    double* energy_deposition_tally, double* scalar_flux_tally,
+    uint64_t* nfacets, uint64_t* ncollisions, const TransportOptions* options);
+
+// Tracks the histories of a bank held outside of the AoS array, where each
+// particle is loaded in full precision for its history and stored again once
+// it reaches census or dies
+void handle_bank_particles(
+    const int global_nx, const int global_ny, const int nx, const int ny,
+    const uint64_t master_key, const int pad, const int x_off, const int y_off,
+    const int initial, const double dt, const int* neighbours,
+    const double* density, const double* edgex, const double* edgey,
+    uint64_t* facets, uint64_t* collisions, const int ntotal_particles,
+    const int nparticles_to_process, ParticleBank* bank,
+    CrossSection* cs_scatter_table, CrossSection* cs_absorb_table,
+    double* energy_deposition_tally, double* scalar_flux_tally,
+    const TransportOptions* options);
+
+// Tracks the full-precision bank through the timestep into tallies of its
+// own, with the same random number streams as the compact bank, ahead of the
+// compact bank being tracked into the tallies
+void track_full_precision_bank(
+    const int global_nx, const int global_ny, const int nx, const int ny,
+    const uint64_t master_key, const int pad, const int x_off, const int y_off,
+    const double dt, const int* neighbours, const double* density,
+    const double* edgex, const double* edgey, const double* edgedx,
+    const double* edgedy, const int ntotal_particles, const int nparticles,
+    Particle* particles, CrossSection* cs_scatter_table,
+    CrossSection* cs_absorb_table, const int tally_ncells,
+    const double* energy_deposition_tally, const double* scalar_flux_tally,
+    const TransportOptions* options);
+
+// Compares the energy the compact bank deposited over the run with the
+// energy deposited by the full-precision bank
+void compare_compact_layout(const int tally_ncells,
+                            const double* energy_deposition_tally);
+
+// Tracks a particle history from its current state until it reaches census,
+// is absorbed, or leaves the tile of cells [tile_x0, tile_x1) x [tile_y0,
+// tile_y1)
+int track_particle_history(
+    const int global_nx, const int global_ny, const int nx, const int ny,
+    const uint64_t master_key, const int pad, const int x_off, const int y_off,
+    const double inv_ntotal_particles, const uint64_t pid, const int tile_x0,
+    const int tile_y0, const int tile_x1, const int tile_y1,
+    const int* neighbours, const double* density, const double* edgex,
+    const double* edgey, Particle* particle, CrossSection* cs_scatter_table,
+    CrossSection* cs_absorb_table, double* energy_deposition_tally,
+    double* scalar_flux_tally, uint64_t* counter, double* local_density,
+    double* energy_deposition, double* scalar_flux, double* number_density,
+    double* microscopic_cs_scatter, double* microscopic_cs_absorb,
+    double* macroscopic_cs_scatter, double* macroscopic_cs_absorb,
+    int* scatter_cs_index, int* absorb_cs_index, double* speed,
+    uint64_t* nfacets, uint64_t* ncollisions, const TransportOptions* options);
+
+// Determines the largest density on the rank, which bounds the macroscopic
+// cross sections a particle of any energy can see
+double calculate_majorant_density(const int nx, const int ny, const int pad,
+                                  const double* density);
+
+// Tracks a particle history to census with Woodcock delta tracking, where
+// flights are sampled against the majorant cross section and the particle
+// only stops at real or virtual collisions and the borders of the rank
+int track_particle_delta(
+    const int global_nx, const int global_ny, const int nx, const int ny,
+    const uint64_t master_key, const int pad, const int x_off, const int y_off,
+    const double inv_ntotal_particles, const uint64_t pid,
+    const double* density, const double* edgex, const double* edgey,
+    Particle* particle, CrossSection* cs_scatter_table,
+    CrossSection* cs_absorb_table, double* energy_deposition_tally,
+    double* scalar_flux_tally, uint64_t* counter, double* local_density,
+    double* energy_deposition, double* scalar_flux, double* number_density,
+    double* microscopic_cs_scatter, double* microscopic_cs_absorb,
+    double* macroscopic_cs_scatter, double* macroscopic_cs_absorb,
+    int* scatter_cs_index, int* absorb_cs_index, double* speed,
+    uint64_t* nfacets, uint64_t* ncollisions, const TransportOptions* options);
+
+// Tracks a particle history to census against the borders of the problem
+// regions, where the particle only stops at collisions, region borders and
+// the borders of the rank, and its tally contributions are split between the
+// cells of the mesh it crosses
+int track_particle_csg(
+    const int global_nx, const int global_ny, const int nx, const int ny,
+    const uint64_t master_key, const int pad, const int x_off, const int y_off,
+    const double inv_ntotal_particles, const uint64_t pid,
+    const double* edgex, const double* edgey, Particle* particle,
+    CrossSection* cs_scatter_table, CrossSection* cs_absorb_table,
+    double* energy_deposition_tally, double* scalar_flux_tally,
+    uint64_t* counter, double* local_density, double* energy_deposition,
+    double* scalar_flux, double* number_density,
+    double* microscopic_cs_scatter, double* microscopic_cs_absorb,
+    double* macroscopic_cs_scatter, double* macroscopic_cs_absorb,
+    int* scatter_cs_index, int* absorb_cs_index, double* speed,
+    uint64_t* nfacets, uint64_t* ncollisions, const TransportOptions* options);
+
+// Handles the current active batch of particles with event-based tracking
+void handle_particles_event_based(
+    const int global_nx, const int global_ny, const int nx, const int ny,
+    const uint64_t master_key, const int pad, const int x_off, const int y_off,
+    const int initial, const double dt, const int* neighbours,
+    const double* density, const double* edgex, const double* edgey,
+    uint64_t* facets, uint64_t* collisions, const int ntotal_particles,
+    const int nparticles_to_process, Particle* particles,
+    CrossSection* cs_scatter_table, CrossSection* cs_absorb_table,
+    double* energy_deposition_tally, double* scalar_flux_tally,
+    const TransportOptions* options);
+
+// Handles the current active batch of particles, starting with event-based
+// sweeps and finishing the remaining histories with history-based tracking
+void handle_particles_hybrid(
+    const int global_nx, const int global_ny, const int nx, const int ny,
+    const uint64_t master_key, const int pad, const int x_off, const int y_off,
+    const int initial, const double dt, const int* neighbours,
+    const double* density, const double* edgex, const double* edgey,
+    uint64_t* facets, uint64_t* collisions, const int ntotal_particles,
+    const int nparticles_to_process, Particle* particles,
+    CrossSection* cs_scatter_table, CrossSection* cs_absorb_table,
+    double* energy_deposition_tally, double* scalar_flux_tally,
+    TransportOptions* options);
+
+// Handles the current active batch of particles tile by tile, handing
+// particles off between tile queues as they cross tile borders
+void handle_particles_tiled(
+    const int global_nx, const int global_ny, const int nx, const int ny,
+    const uint64_t master_key, const int pad, const int x_off, const int y_off,
+    const int initial, const double dt, const int* neighbours,
+    const double* density, const double* edgex, const double* edgey,
+    uint64_t* facets, uint64_t* collisions, const int ntotal_particles,
+    const int nparticles_to_process, Particle* particles,
+    CrossSection* cs_scatter_table, CrossSection* cs_absorb_table,
+    double* energy_deposition_tally, double* scalar_flux_tally,
+    const TransportOptions* options);
+
+// Initialises the per-particle state ahead of the first sweep
+uint64_t initialise_event_state(
+    const int nx, const uint64_t master_key, const int pad, const int x_off,
+    const int y_off, const int initial, const double dt,
+    const double* density, const int nparticles_to_process,
+    Particle* particles, CrossSection* cs_scatter_table,
+    CrossSection* cs_absorb_table, EventState* state, int* live,
+    const TransportOptions* options);
+
+// Stably partitions the particles into a queue for each key, with the queues
+// stored contiguously in key order
+void partition_particles(const int nparticles, const int* pids,
+                         const int* key, const int nkeys, int* queue,
+                         int* nqueue);
+
+// Maps the columns and rows of the global mesh onto a coarse tally mesh of
+// tally_nx x tally_ny cells that each gather a block of whole cells
+void map_tally_mesh(const int global_nx, const int global_ny,
+                    TransportOptions* options);
+
+// Allocates a private tally buffer for every thread
+void initialise_tally_buffers(void);
+
+// Adds a contribution to the private tally buffer, flushing the buffer into
+// the tallies when it becomes too full to probe efficiently
+void add_to_tally_buffer(TallyBuffer* buffer, const int cell,
+                         const double value, const double flux_value,
+                         double* tally, double* flux_tally);
+
+// Reduces the private tally buffers of all threads into the tallies
+void reduce_tally_buffers(double* tally, double* flux_tally);
+
+// Allocates the per-particle state for event-based tracking
+size_t allocate_event_state(EventState* state, const int nparticles);
+
+// Stores the entries of each particle's last lookups with the particle, to
+// start its searches in the next timestep
+void store_cs_indices(const int nparticles, Particle* particles,
+                      const EventState* state);
+
+// Deallocates the per-particle state for event-based tracking
+void deallocate_event_state(EventState* state);
 
 // Handle facet event
 int facet_event(const int global_nx, const int global_ny, const int nx,
@@ -21,55 +311,100 @@ int facet_event(const int global_nx, const int global_ny, const int nx,
                 const double distance_to_facet, const double speed,
                 const double cell_mfp, const int x_facet, const double* density,
                 const int* neighbours, Particle* particle,
-                double* energy_deposition, double* number_density,
-                double* microscopic_cs_scatter, double* microscopic_cs_absorb,
-                double* macroscopic_cs_scatter, double* macroscopic_cs_absorb,
-                double* energy_deposition_tally, int* cellx, int* celly,
-                double* local_density);
+                double* energy_deposition, double* scalar_flux,
+                double* number_density, double* microscopic_cs_scatter,
+                double* microscopic_cs_absorb, double* macroscopic_cs_scatter,
+                double* macroscopic_cs_absorb, double* energy_deposition_tally,
+                double* scalar_flux_tally, int* cellx, int* celly,
+                double* local_density, const TransportOptions* options);
 
 // Handles a collision event
 int collision_event(
     const int global_nx, const int nx, const int x_off, const int y_off,
     const uint64_t pkey, const uint64_t master_key,
     const double inv_ntotal_particles, const double distance_to_collision,
-    const double local_density, const CrossSection* cs_scatter_table,
-    const CrossSection* cs_absorb_table, Particle* particle, uint64_t* counter,
-    double* energy_deposition, double* number_density,
+    const CrossSection* cs_scatter_table, const CrossSection* cs_absorb_table,
+    Particle* particle, uint64_t* counter, double* energy_deposition,
+    double* scalar_flux, double* number_density,
     double* microscopic_cs_scatter, double* microscopic_cs_absorb,
     double* macroscopic_cs_scatter, double* macroscopic_cs_absorb,
-    double* energy_deposition_tally, int* scatter_cs_index,
-    int* absorb_cs_index, double rn[NRANDOM_NUMBERS], double* speed);
+    double* energy_deposition_tally, double* scalar_flux_tally,
+    int* scatter_cs_index, int* absorb_cs_index, double rn[NRANDOM_NUMBERS],
+    double* speed, const TransportOptions* options);
 
 void census_event(const int global_nx, const int nx, const int x_off,
                   const int y_off, const double inv_ntotal_particles,
                   const double distance_to_census, const double cell_mfp,
                   Particle* particle, double* energy_deposition,
-                  double* number_density, double* microscopic_cs_scatter,
-                  double* microscopic_cs_absorb,
-                  double* energy_deposition_tally);
+                  double* scalar_flux, double* number_density,
+                  double* microscopic_cs_scatter, double* microscopic_cs_absorb,
+                  double* energy_deposition_tally, double* scalar_flux_tally,
+                  const TransportOptions* options);
 
-// Tallies the energy deposition in the cell
+// Tallies the energy deposition and scalar flux in the particle's tally cell
 void update_tallies(const int nx, const int x_off, const int y_off,
                     Particle* particle, const double inv_ntotal_particles,
-                    const double energy_deposition,
-                    double* energy_deposition_tally);
+                    const double energy_deposition, const double scalar_flux,
+                    double* energy_deposition_tally, double* scalar_flux_tally,
+                    const TransportOptions* options);
+
+// Checks whether moving between two cells takes the particle into another
+// cell of the tally mesh
+int enters_tally_cell(const int cellx, const int celly, const int next_cellx,
+                      const int next_celly, const TransportOptions* options);
 
 // Handle the collision event, including absorption and scattering
 int handle_collision(Particle* particle, const double macroscopic_cs_absorb,
                      uint64_t* counter, const double macroscopic_cs_total,
                      const double distance_to_collision);
 
-// Sends a particle to a neighbour and replaces in the particle list
-void send_and_mark_particle(const int destination, Particle* particle);
+// Marks a particle that has left the rank to be sent to its neighbour
+void send_and_mark_particle(const int pid, Particle* particle);
+
+// Prepares the exchange of the particles that leave the rank this timestep
+void initialise_particle_exchange(const int capacity);
+
+// Determines whether the rank shares a border with any other rank
+int has_neighbouring_ranks(const int* neighbours);
+
+// Tracks the particles from ntracked onwards while exchanging the particles
+// that leave the rank with the neighbouring ranks, resuming the received
+// particles until every rank reaches census
+void migrate_particles(
+    const int global_nx, const int global_ny, const int nx, const int ny,
+    const uint64_t master_key, const int pad, const int x_off, const int y_off,
+    const double dt, const int* neighbours, const double* density,
+    const double* edgex, const double* edgey, uint64_t* facets,
+    uint64_t* collisions, const int ntotal_particles, const int ntracked,
+    int* nparticles, Particle* particles, CrossSection* cs_scatter_table,
+    CrossSection* cs_absorb_table, double* energy_deposition_tally,
+    double* scalar_flux_tally, const TransportOptions* options);
 
 // Calculate the distance to the next facet
 void calc_distance_to_facet(const int global_nx, const double x, const double y,
                             const int pad, const int x_off, const int y_off,
                             const double omega_x, const double omega_y,
-                            const double speed, const int particle_cellx,
-                            const int particle_celly, double* distance_to_facet,
-                            int* x_facet, const double* edgex,
-                            const double* edgey);
+                            const int particle_cellx, const int particle_celly,
+                            double* distance_to_facet, int* x_facet,
+                            const double* edgex, const double* edgey);
+
+// Calculate the distances along the particle's direction to the next x and y
+// facets of its cell, and the scales converting the width of a cell into the
+// distance between its facets along the direction
+void start_facet_traversal(
+    const double x, const double y, const int pad, const int x_off,
+    const int y_off, const double omega_x, const double omega_y,
+    const int particle_cellx, const int particle_celly, const double* edgex,
+    const double* edgey, double* distance_to_x_facet,
+    double* distance_to_y_facet, double* x_facet_scale,
+    double* y_facet_scale);
+
+// Calculate the distance to the nearest facet of the particle's cell in any
+// direction, less the correction for the open bounds
+double calc_safety_distance(const double x, const double y, const int pad,
+                            const int x_off, const int y_off,
+                            const int particle_cellx, const int particle_celly,
+                            const double* edgex, const double* edgey);
 
 // Calculate the energy deposition in the cell
 double calculate_energy_deposition(
@@ -78,9 +413,111 @@ double calculate_energy_deposition(
     const double path_length, const double number_density,
     const double microscopic_cs_absorb, const double microscopic_cs_total);
 
+// Fetches the density and number density of a cell, through the material map
+// when the mesh has one
+void cell_densities(const double* density, const int index,
+                    double* local_density, double* number_density,
+                    const TransportOptions* options);
+
+// Builds the material map of the local cells, unless the mesh is unchanged
+// since it was last built
+void map_materials(const int nx, const int ny, const int pad, const int x_off,
+                   const int y_off, const double* density,
+                   TransportOptions* options);
+
+// Builds the quadtree of uniform macro-cells over the local cells, where a
+// macro-cell of level L is an aligned block of 2^L x 2^L cells, clipped to the
+// mesh, that all have the same density
+const uint8_t* build_macro_cells(const int nx, const int ny, const int pad,
+                                 const int x_off, const int y_off,
+                                 const double* density);
+
+// Crosses the facets inside the uniform macro-cell holding the particle, and
+// inside the tile, without stopping until the next collision or census,
+// returning the distance travelled
+double cross_macro_cell(
+    const int global_nx, const int nx, const int ny, const int pad,
+    const int x_off, const int y_off, const int tile_x0, const int tile_y0,
+    const int tile_x1, const int tile_y1, const double inv_ntotal_particles,
+    const double distance_to_collision, const double distance_to_census,
+    const double cell_mfp, const double speed, const double* edgex,
+    const double* edgey, const double x_facet_scale,
+    const double y_facet_scale, Particle* particle,
+    double* distance_to_x_facet, double* distance_to_y_facet,
+    double* energy_deposition, double* scalar_flux,
+    const double number_density, const double microscopic_cs_scatter,
+    const double microscopic_cs_absorb, double* energy_deposition_tally,
+    double* scalar_flux_tally, uint64_t* nfacets,
+    const TransportOptions* options);
+
+// Selects the SIMD kernels of the widest instruction set the CPU supports,
+// returning their lanes, or 0 when only the scalar kernels can run
+int select_simd_kernels(void);
+
+// Determines the next event that each live particle will encounter, a batch
+// of particles at a time
+void classify_events_simd(const int global_nx, const int pad, const int x_off,
+                          const int y_off, const int nlive, const int* live,
+                          Particle* particles, const double* edgex,
+                          const double* edgey, EventState* state,
+                          const TransportOptions* options);
+
+// Handles the collision events of the queued particles, a batch of particles
+// at a time
+void collision_events_simd(
+    const int nx, const int x_off, const int y_off, const uint64_t master_key,
+    const double inv_ntotal_particles, const int nqueue, const int* queue,
+    const CrossSection* cs_scatter_table, const CrossSection* cs_absorb_table,
+    Particle* particles, EventState* state, double* energy_deposition_tally,
+    double* scalar_flux_tally, const TransportOptions* options);
+
+// Handles the facet events of the queued particles, a batch of particles at a
+// time
+void facet_events_simd(const int global_nx, const int global_ny, const int nx,
+                       const int ny, const int x_off, const int y_off,
+                       const double inv_ntotal_particles, const int nqueue,
+                       const int* queue, const double* density,
+                       Particle* particles, EventState* state,
+                       double* energy_deposition_tally,
+                       double* scalar_flux_tally,
+                       const TransportOptions* options);
+
 // Fetch the cross section for a particular energy value
 double microscopic_cs_for_energy(const CrossSection* cs, const double energy,
                                  int* cs_index);
 
+// Fetch the scattering and absorption cross sections for a particular energy,
+// with a single search when the tables share a unionized grid
+void microscopic_cs_for_reactions(
+    const CrossSection* cs_scatter_table, const CrossSection* cs_absorb_table,
+    const double energy, int* scatter_cs_index, int* absorb_cs_index,
+    double* microscopic_cs_scatter, double* microscopic_cs_absorb,
+    const TransportOptions* options);
+
+// Fetch the cross section of every reaction of a unionized grid for a
+// particular energy, interpolated from the same interval
+void microscopic_cs_unionized(const CrossSection* cs, const double energy,
+                              int* cs_index, double* microscopic_cs);
+
+// Finds the entry whose interval holds an energy, starting from the entry of
+// the particle's previous lookup when it has one
+int cs_entry(const CrossSection* cs, const double energy, int* cs_index);
+
+// Finds the entry whose interval holds an energy below the upper key of the
+// hinted entry, galloping downwards in doubling steps and then bisecting
+int cs_entry_galloping(const CrossSection* cs, const double energy,
+                       const int hint);
+
+// Finds the entry whose interval holds an energy by searching the whole table
+int cs_entry_binary(const CrossSection* cs, const double energy);
+
+// Finds the entry whose interval holds an energy by searching only the
+// entries of its bin in the log-energy hash grid
+int cs_entry_hashed(const CrossSection* cs, const double energy);
+
+// Times lookups of a cross section table through the log-energy hash grid
+// against the binary search of the whole table
+void benchmark_cs_lookup(const CrossSection* cs, const int nlookups);
+
 void generate_random_numbers(const uint64_t pkey, const uint64_t master_key,
                              const uint64_t counter, double* rn0, double* rn1);
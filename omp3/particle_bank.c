@@ -0,0 +1,150 @@
+#include "neutral.h"
+#include "../../comms.h"
+#include "../../shared.h"
+#include "../neutral_interface.h"
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// The tallies of the full-precision bank tracked alongside the compact bank
+static double* full_precision_tally = NULL;
+static double* full_precision_flux_tally = NULL;
+static int full_precision_ncells = 0;
+
+// The energy deposited this timestep by the full-precision bank, and the
+// energy the compact bank's tally held before the timestep
+static double full_precision_deposition = 0.0;
+static double compact_tally_start = 0.0;
+
+// The energy deposited by each bank over the run so far
+static double full_precision_total = 0.0;
+static double compact_total = 0.0;
+
+// Sums the energy deposition tally
+static double sum_tally(const int ncells, const double* tally);
+
+// Tracks the histories of a bank held outside of the AoS array, where each
+// particle is loaded in full precision for its history and stored again once
+// it reaches census or dies
+void handle_bank_particles(
+    const int global_nx, const int global_ny, const int nx, const int ny,
+    const uint64_t master_key, const int pad, const int x_off, const int y_off,
+    const int initial, const double dt, const int* neighbours,
+    const double* density, const double* edgex, const double* edgey,
+    uint64_t* facets, uint64_t* collisions, const int ntotal_particles,
+    const int nparticles_to_process, ParticleBank* bank,
+    CrossSection* cs_scatter_table, CrossSection* cs_absorb_table,
+    double* energy_deposition_tally, double* scalar_flux_tally,
+    const TransportOptions* options) {
+
+  uint64_t nfacets = 0;
+  uint64_t ncollisions = 0;
+  uint64_t nparticles = 0;
+
+  // Each thread takes whole blocks of the AoSoA layout
+#pragma omp parallel for schedule(static, PARTICLE_BLOCK_SIZE)                \
+    reduction(+ : nfacets, ncollisions, nparticles)
+  for (int pid = 0; pid < nparticles_to_process; ++pid) {
+    // The bank never leaves the rank, so the particle's cell is always local
+    Particle particle;
+    load_particle(bank, pid, pad, x_off, y_off, edgex, edgey, &particle);
+    if (particle.dead) {
+      continue;
+    }
+
+    nparticles++;
+
+    handle_particle(global_nx, global_ny, nx, ny, master_key, pad, x_off,
+                    y_off, initial, dt, pid, neighbours, density, edgex, edgey,
+                    ntotal_particles, &particle, cs_scatter_table,
+                    cs_absorb_table, energy_deposition_tally,
+                    scalar_flux_tally, &nfacets, &ncollisions, options);
+    store_particle(bank, pid, pad, x_off, y_off, edgex, edgey, &particle);
+  }
+
+  // Store a total number of facets and collisions
+  *facets += nfacets;
+  *collisions += ncollisions;
+
+  printf("Particles  %llu\n", (unsigned long long)nparticles);
+}
+
+// Tracks the full-precision bank through the timestep into tallies of its
+// own, with the same random number streams as the compact bank, ahead of the
+// compact bank being tracked into the tallies
+void track_full_precision_bank(
+    const int global_nx, const int global_ny, const int nx, const int ny,
+    const uint64_t master_key, const int pad, const int x_off, const int y_off,
+    const double dt, const int* neighbours, const double* density,
+    const double* edgex, const double* edgey, const double* edgedx,
+    const double* edgedy, const int ntotal_particles, const int nparticles,
+    Particle* particles, CrossSection* cs_scatter_table,
+    CrossSection* cs_absorb_table, const int tally_ncells,
+    const double* energy_deposition_tally, const double* scalar_flux_tally,
+    const TransportOptions* options) {
+
+  if (full_precision_ncells != tally_ncells) {
+    free(full_precision_tally);
+    free(full_precision_flux_tally);
+    full_precision_tally = (double*)malloc(sizeof(double) * tally_ncells);
+    full_precision_flux_tally = (double*)malloc(sizeof(double) * tally_ncells);
+    if (!full_precision_tally || !full_precision_flux_tally) {
+      TERMINATE("Could not allocate the full-precision tallies.\n");
+    }
+    full_precision_ncells = tally_ncells;
+  }
+
+#pragma omp parallel for
+  for (int ii = 0; ii < tally_ncells; ++ii) {
+    full_precision_tally[ii] = 0.0;
+    full_precision_flux_tally[ii] = 0.0;
+  }
+
+  // The events of the full-precision bank are left out of the counts
+  uint64_t nfacets = 0;
+  uint64_t ncollisions = 0;
+  double* flux_tally = (scalar_flux_tally) ? full_precision_flux_tally : NULL;
+  handle_particles(global_nx, global_ny, nx, ny, master_key, pad, x_off, y_off,
+                   1, dt, neighbours, density, edgex, edgey, edgedx, edgedy,
+                   &nfacets, &ncollisions, ntotal_particles, nparticles,
+                   particles, cs_scatter_table, cs_absorb_table,
+                   full_precision_tally, flux_tally, options);
+
+  // The buffered contributions have to land before the compact bank's
+  if (options->tally_mode != ATOMIC_TALLY) {
+    reduce_tally_buffers(full_precision_tally, flux_tally);
+  }
+
+  full_precision_deposition = sum_tally(tally_ncells, full_precision_tally);
+  compact_tally_start = sum_tally(tally_ncells, energy_deposition_tally);
+}
+
+// Compares the energy the compact bank deposited over the run with the
+// energy deposited by the full-precision bank
+void compare_compact_layout(const int tally_ncells,
+                            const double* energy_deposition_tally) {
+
+  full_precision_total += full_precision_deposition;
+  compact_total +=
+      sum_tally(tally_ncells, energy_deposition_tally) - compact_tally_start;
+
+  printf("Compact layout deposition %.12e, full precision %.12e\n",
+         compact_total, full_precision_total);
+  if (within_tolerance(full_precision_total, compact_total,
+                       VALIDATE_TOLERANCE)) {
+    printf("Compact layout PASSED validation.\n");
+  } else {
+    printf("Compact layout FAILED validation.\n");
+  }
+}
+
+// Sums the energy deposition tally
+static double sum_tally(const int ncells, const double* tally) {
+
+  double sum = 0.0;
+#pragma omp parallel for reduction(+ : sum)
+  for (int ii = 0; ii < ncells; ++ii) {
+    sum += tally[ii];
+  }
+  return sum;
+}
@@ -0,0 +1,126 @@
+#include "neutral.h"
+#include "../../comms.h"
+#include "../../shared.h"
+#include "../neutral_interface.h"
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Interleaves the bits of the cell indices into a Morton key
+static inline uint64_t morton_key(const uint32_t cellx, const uint32_t celly);
+
+// Spreads the lower 32 bits of a value across the even bits
+static inline uint64_t spread_bits(uint64_t v);
+
+// Sorts the particles into cell order so that neighbouring histories share
+// the density, edge and tally cache lines
+void sort_particles(const int nx, const int ny, const int x_off,
+                    const int y_off, const int sort_mode,
+                    const int nparticles, Particle* particles) {
+
+  int nthreads = 0;
+#pragma omp parallel
+  { nthreads = omp_get_num_threads(); }
+
+  // Determine the range of the keys, Morton keys span a power of two square
+  uint64_t max_key = (uint64_t)nx * ny;
+  if (sort_mode == MORTON_SORT) {
+    uint64_t dim = 1;
+    while (dim < (uint64_t)max(nx, ny)) {
+      dim <<= 1;
+    }
+    max_key = dim * dim;
+  }
+
+  // Coarsen the keys so the per-thread histograms stay small, neighbouring
+  // cells still land in the same bucket so the locality is retained, and the
+  // dead particles are given a bucket of their own after the cells
+  int shift = 0;
+  while (((max_key - 1) >> shift) >= SORT_MAX_BUCKETS) {
+    shift++;
+  }
+  const int dead_bucket = ((max_key - 1) >> shift) + 1;
+  const int nbuckets = dead_bucket + 1;
+
+  int* bucket = (int*)malloc(sizeof(int) * nparticles);
+  int* offsets = (int*)malloc(sizeof(int) * nthreads * nbuckets);
+  if (!bucket || !offsets) {
+    TERMINATE("Could not allocate the particle sort buffers.\n");
+  }
+
+  // The bank is allocated with twice the particles, so the upper half is
+  // free to be used as the destination of the counting sort
+  Particle* sorted = &particles[nparticles];
+
+#pragma omp parallel
+  {
+    const int tid = omp_get_thread_num();
+    const int np_per_thread = nparticles / nthreads;
+    const int np_remainder = nparticles % nthreads;
+    const int start = tid * np_per_thread + min(tid, np_remainder);
+    const int end = start + np_per_thread + (tid < np_remainder);
+    int* thread_offsets = &offsets[tid * nbuckets];
+
+    memset(thread_offsets, 0, sizeof(int) * nbuckets);
+    for (int pp = start; pp < end; ++pp) {
+      const Particle* particle = &particles[pp];
+      const int cellx = particle->cellx - x_off;
+      const int celly = particle->celly - y_off;
+
+      // Dead particles are gathered at the end of the bank
+      if (particle->dead) {
+        bucket[pp] = dead_bucket;
+      } else {
+        const uint64_t key = (sort_mode == MORTON_SORT)
+                                 ? morton_key(cellx, celly)
+                                 : (uint64_t)celly * nx + cellx;
+        bucket[pp] = key >> shift;
+      }
+      thread_offsets[bucket[pp]]++;
+    }
+
+#pragma omp barrier
+
+    // Exclusive scan over the buckets, ordering threads within each bucket so
+    // that the sort is stable
+#pragma omp single
+    {
+      int off = 0;
+      for (int bb = 0; bb < nbuckets; ++bb) {
+        for (int tt = 0; tt < nthreads; ++tt) {
+          const int count = offsets[tt * nbuckets + bb];
+          offsets[tt * nbuckets + bb] = off;
+          off += count;
+        }
+      }
+    }
+
+    for (int pp = start; pp < end; ++pp) {
+      sorted[thread_offsets[bucket[pp]]++] = particles[pp];
+    }
+
+#pragma omp barrier
+
+    memcpy(&particles[start], &sorted[start], sizeof(Particle) * (end - start));
+  }
+
+  free(bucket);
+  free(offsets);
+}
+
+// Interleaves the bits of the cell indices into a Morton key
+static inline uint64_t morton_key(const uint32_t cellx, const uint32_t celly) {
+  return spread_bits(cellx) | (spread_bits(celly) << 1);
+}
+
+// Spreads the lower 32 bits of a value across the even bits
+static inline uint64_t spread_bits(uint64_t v) {
+  v &= 0x00000000FFFFFFFFULL;
+  v = (v | (v << 16)) & 0x0000FFFF0000FFFFULL;
+  v = (v | (v << 8)) & 0x00FF00FF00FF00FFULL;
+  v = (v | (v << 4)) & 0x0F0F0F0F0F0F0F0FULL;
+  v = (v | (v << 2)) & 0x3333333333333333ULL;
+  v = (v | (v << 1)) & 0x5555555555555555ULL;
+  return v;
+}
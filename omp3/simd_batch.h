@@ -0,0 +1,571 @@
+// The batch kernels of the event-based sweeps, included by simd_kernels.c once
+// for each instruction set with SIMD_LANES set to the particles in a batch and
+// SIMD_NAME suffixing the names of its kernels. The particles of a batch are
+// gathered into an array for each field, the lanes are computed together and
+// the results scattered back. Lanes beyond the end of the last batch repeat
+// its last particle and are never stored.
+
+// Fills the lanes of a batch with its particles, repeating the last particle
+// in the lanes beyond the end of the batch
+static inline void SIMD_NAME(fill_lanes)(const int* pids, const int nlanes,
+                                         int* lane_pids) {
+
+  for (int ll = 0; ll < SIMD_LANES; ++ll) {
+    lane_pids[ll] = pids[min(ll, nlanes - 1)];
+  }
+}
+
+// Converts an integer to the nearest double, as a cast does, from its halves
+// offset into the mantissas of doubles by exact subtractions, as AVX2 has no
+// conversion of 64-bit integers
+static inline double SIMD_NAME(uint64_to_double)(const uint64_t value) {
+
+  const uint64_t hi_bits = (value >> 32) | UINT64_C(0x4530000000000000);
+  const uint64_t lo_bits = (value & UINT64_C(0xFFFFFFFF)) |
+                           UINT64_C(0x4330000000000000);
+  double hi;
+  double lo;
+  memcpy(&hi, &hi_bits, sizeof(hi));
+  memcpy(&lo, &lo_bits, sizeof(lo));
+  return (hi - 19342813118337666422669312.0) + lo;
+}
+
+// Generates the pair of random numbers of a particle's stream at a counter,
+// matching generate_random_numbers
+static inline void SIMD_NAME(random_numbers)(const uint64_t pkey,
+                                             const uint64_t master_key,
+                                             const uint64_t counter,
+                                             double* rn0, double* rn1) {
+
+  const uint64_t ks[3] = {pkey, master_key,
+                          THREEFRY_PARITY ^ pkey ^ master_key};
+  uint64_t x0 = counter + ks[0];
+  uint64_t x1 = ks[1];
+  THREEFRY_ROUNDS(x0, x1, ks, 1, 16, 42, 12, 31)
+  THREEFRY_ROUNDS(x0, x1, ks, 2, 16, 32, 24, 21)
+  THREEFRY_ROUNDS(x0, x1, ks, 3, 16, 42, 12, 31)
+  THREEFRY_ROUNDS(x0, x1, ks, 4, 16, 32, 24, 21)
+  THREEFRY_ROUNDS(x0, x1, ks, 5, 16, 42, 12, 31)
+
+  const double factor = 1.0 / (UINT64_C(0xFFFFFFFFFFFFFFFF) + 1.0);
+  const double half_factor = 0.5 * factor;
+  *rn0 = SIMD_NAME(uint64_to_double)(x0) * factor + half_factor;
+  *rn1 = SIMD_NAME(uint64_to_double)(x1) * factor + half_factor;
+}
+
+// The natural logarithm of a positive normal number, reducing it to a
+// mantissa in [sqrt(2)/2, sqrt(2)) and an exponent by manipulating its bits,
+// with the polynomial of the fdlibm log
+static inline double SIMD_NAME(simd_log)(const double x) {
+
+  uint64_t bits;
+  memcpy(&bits, &x, sizeof(bits));
+  const uint64_t exponent_bits = (bits >> 52) | UINT64_C(0x4330000000000000);
+  const uint64_t mantissa_bits =
+      (bits & UINT64_C(0x000FFFFFFFFFFFFF)) | UINT64_C(0x3FF0000000000000);
+  double biased_exponent;
+  double mantissa;
+  memcpy(&biased_exponent, &exponent_bits, sizeof(biased_exponent));
+  memcpy(&mantissa, &mantissa_bits, sizeof(mantissa));
+
+  // The biased exponent sits in the mantissa of 2^52
+  const int high = (mantissa > M_SQRT2);
+  const double exponent =
+      (biased_exponent - (4503599627370496.0 + 1023.0)) + (high ? 1.0 : 0.0);
+  const double f = mantissa * ((high) ? 0.5 : 1.0) - 1.0;
+  const double s = f / (2.0 + f);
+  const double z = s * s;
+  const double w = z * z;
+  const double t1 =
+      w * (3.999999999940941908e-01 +
+           w * (2.222219843214978396e-01 + w * 1.531383769920937332e-01));
+  const double t2 =
+      z * (6.666666666666735130e-01 +
+           w * (2.857142874366239149e-01 +
+                w * (1.818357216161805012e-01 +
+                     w * 1.479819860511658591e-01)));
+  const double r = t2 + t1;
+  const double hfsq = 0.5 * f * f;
+  return exponent * 6.93147180369123816490e-01 -
+         ((hfsq - (s * (hfsq + r) + exponent * 1.90821492927058770002e-10)) -
+          f);
+}
+
+// The energy deposited along a path, matching calculate_energy_deposition
+static inline double SIMD_NAME(energy_deposition)(
+    const double energy, const double weight, const double path_length,
+    const double number_density, const double microscopic_cs_absorb,
+    const double microscopic_cs_total) {
+
+  const double average_exit_energy_absorb = 0.0;
+  const double absorption_heating =
+      (microscopic_cs_absorb / microscopic_cs_total) *
+      average_exit_energy_absorb;
+  const double average_exit_energy_scatter =
+      energy *
+      ((MASS_NO * MASS_NO + MASS_NO + 1) / ((MASS_NO + 1) * (MASS_NO + 1)));
+  const double scattering_heating =
+      (1.0 - (microscopic_cs_absorb / microscopic_cs_total)) *
+      average_exit_energy_scatter;
+  const double heating_response =
+      (energy - scattering_heating - absorption_heating);
+  return weight * path_length * (microscopic_cs_total * BARNS) *
+         heating_response * number_density;
+}
+
+// Determines the next event of a batch of live particles, as classify_events
+static void SIMD_NAME(classify_batch)(const int global_nx, const int pad,
+                                      const int x_off, const int y_off,
+                                      const int* pids, const int nlanes,
+                                      const Particle* particles,
+                                      const double* edgex, const double* edgey,
+                                      EventState* state) {
+
+  double x[SIMD_LANES];
+  double y[SIMD_LANES];
+  double omega_x[SIMD_LANES];
+  double omega_y[SIMD_LANES];
+  double mfp_to_collision[SIMD_LANES];
+  double dt_to_census[SIMD_LANES];
+  double macroscopic_cs_total[SIMD_LANES];
+  double speed[SIMD_LANES];
+  double lower_x[SIMD_LANES];
+  double upper_x[SIMD_LANES];
+  double lower_y[SIMD_LANES];
+  double upper_y[SIMD_LANES];
+  int live[SIMD_LANES];
+
+  int lane_pids[SIMD_LANES];
+  SIMD_NAME(fill_lanes)(pids, nlanes, lane_pids);
+
+#pragma omp simd
+  for (int ll = 0; ll < SIMD_LANES; ++ll) {
+    const int pid = lane_pids[ll];
+    const Particle* particle = &particles[pid];
+    x[ll] = particle->x;
+    y[ll] = particle->y;
+    omega_x[ll] = particle->omega_x;
+    omega_y[ll] = particle->omega_y;
+    mfp_to_collision[ll] = particle->mfp_to_collision;
+    dt_to_census[ll] = particle->dt_to_census;
+    live[ll] = (!particle->dead) & (particle->dt_to_census > 0.0);
+    const int cellx = particle->cellx - x_off + pad;
+    const int celly = particle->celly - y_off + pad;
+
+    // The open bounds are corrected for as in calc_distance_to_facet
+    lower_x[ll] = edgex[cellx] - OPEN_BOUND_CORRECTION;
+    upper_x[ll] = edgex[cellx + 1];
+    lower_y[ll] = edgey[celly] - OPEN_BOUND_CORRECTION;
+    upper_y[ll] = edgey[celly + 1];
+    macroscopic_cs_total[ll] =
+        state->macroscopic_cs_scatter[pid] + state->macroscopic_cs_absorb[pid];
+    speed[ll] = state->speed[pid];
+  }
+
+  double cell_mfp[SIMD_LANES];
+  double distance_to_event[SIMD_LANES];
+  int x_facet[SIMD_LANES];
+  int event[SIMD_LANES];
+
+#pragma omp simd
+  for (int ll = 0; ll < SIMD_LANES; ++ll) {
+    cell_mfp[ll] = 1.0 / macroscopic_cs_total[ll];
+
+    // The facet ahead along each axis is selected by the sign of the direction
+    const double facet_x = (omega_x[ll] >= 0.0) ? upper_x[ll] : lower_x[ll];
+    const double facet_y = (omega_y[ll] >= 0.0) ? upper_y[ll] : lower_y[ll];
+    const double distance_x = (facet_x - x[ll]) / omega_x[ll];
+    const double distance_y = (facet_y - y[ll]) / omega_y[ll];
+    x_facet[ll] = (distance_x < distance_y);
+    const double distance_to_facet = x_facet[ll] ? distance_x : distance_y;
+
+    const double distance_to_collision = mfp_to_collision[ll] * cell_mfp[ll];
+    const double distance_to_census = speed[ll] * dt_to_census[ll];
+    const int collision = (distance_to_collision < distance_to_facet) &
+                          (distance_to_collision < distance_to_census);
+    const int facet = (!collision) & (distance_to_facet < distance_to_census);
+    event[ll] = (!live[ll]) ? NO_EVENT
+                            : (collision) ? COLLISION_EVENT
+                                          : (facet) ? FACET_EVENT
+                                                    : CENSUS_EVENT;
+    distance_to_event[ll] = (collision) ? distance_to_collision
+                                        : (facet) ? distance_to_facet
+                                                  : distance_to_census;
+  }
+
+  for (int ll = 0; ll < nlanes; ++ll) {
+    const int pid = pids[ll];
+    state->event[pid] = event[ll];
+    if (live[ll]) {
+      state->cell_mfp[pid] = cell_mfp[ll];
+      state->x_facet[pid] = x_facet[ll];
+      state->distance_to_event[pid] = distance_to_event[ll];
+    }
+  }
+}
+
+// Handles the collision events of a batch of particles, as collision_event.
+// The cross section tables are searched lane by lane, as each search takes a
+// different path, and the entries found are interpolated together.
+static void SIMD_NAME(collision_batch)(
+    const int nx, const int x_off, const int y_off, const uint64_t master_key,
+    const double inv_ntotal_particles, const int* pids, const int nlanes,
+    const CrossSection* cs_scatter_table, const CrossSection* cs_absorb_table,
+    Particle* particles, EventState* state, double* energy_deposition_tally,
+    double* scalar_flux_tally, const TransportOptions* options) {
+
+  const uint64_t particle_key_offset = options->particle_key_offset;
+  const CrossSection* unionized_table = options->unionized_table;
+
+  double x[SIMD_LANES];
+  double y[SIMD_LANES];
+  double omega_x[SIMD_LANES];
+  double omega_y[SIMD_LANES];
+  double energy[SIMD_LANES];
+  double weight[SIMD_LANES];
+  double mfp_to_collision[SIMD_LANES];
+  double dt_to_census[SIMD_LANES];
+  double distance[SIMD_LANES];
+  double number_density[SIMD_LANES];
+  double microscopic_cs_scatter[SIMD_LANES];
+  double microscopic_cs_absorb[SIMD_LANES];
+  double macroscopic_cs_scatter[SIMD_LANES];
+  double macroscopic_cs_absorb[SIMD_LANES];
+  double speed[SIMD_LANES];
+  double energy_deposition[SIMD_LANES];
+  double scalar_flux[SIMD_LANES];
+  uint64_t pkey[SIMD_LANES];
+  uint64_t counter[SIMD_LANES];
+  int scatter_cs_index[SIMD_LANES];
+  int absorb_cs_index[SIMD_LANES];
+  int dead[SIMD_LANES];
+
+  int lane_pids[SIMD_LANES];
+  SIMD_NAME(fill_lanes)(pids, nlanes, lane_pids);
+
+#pragma omp simd
+  for (int ll = 0; ll < SIMD_LANES; ++ll) {
+    const int pid = lane_pids[ll];
+    const Particle* particle = &particles[pid];
+    x[ll] = particle->x;
+    y[ll] = particle->y;
+    omega_x[ll] = particle->omega_x;
+    omega_y[ll] = particle->omega_y;
+    energy[ll] = particle->energy;
+    weight[ll] = particle->weight;
+    dt_to_census[ll] = particle->dt_to_census;
+    distance[ll] = state->distance_to_event[pid];
+    number_density[ll] = state->number_density[pid];
+    microscopic_cs_scatter[ll] = state->microscopic_cs_scatter[pid];
+    microscopic_cs_absorb[ll] = state->microscopic_cs_absorb[pid];
+    macroscopic_cs_scatter[ll] = state->macroscopic_cs_scatter[pid];
+    macroscopic_cs_absorb[ll] = state->macroscopic_cs_absorb[pid];
+    speed[ll] = state->speed[pid];
+    energy_deposition[ll] = state->energy_deposition[pid];
+    scalar_flux[ll] = state->scalar_flux[pid];
+    pkey[ll] = particle_key_offset + pid;
+    counter[ll] = state->counter[pid];
+    scatter_cs_index[ll] = state->scatter_cs_index[pid];
+    absorb_cs_index[ll] = state->absorb_cs_index[pid];
+  }
+
+  // Move to the collision site and model the absorption or elastic scatter,
+  // masking the new direction and energy to the lanes that scatter
+#pragma omp simd
+  for (int ll = 0; ll < SIMD_LANES; ++ll) {
+    energy_deposition[ll] += SIMD_NAME(energy_deposition)(
+        energy[ll], weight[ll], distance[ll], number_density[ll],
+        microscopic_cs_absorb[ll],
+        microscopic_cs_scatter[ll] + microscopic_cs_absorb[ll]);
+
+    // The flux is accumulated in every lane, and only kept when it is tallied
+    scalar_flux[ll] += weight[ll] * distance[ll];
+    x[ll] += distance[ll] * omega_x[ll];
+    y[ll] += distance[ll] * omega_y[ll];
+
+    const double p_absorb =
+        macroscopic_cs_absorb[ll] /
+        (macroscopic_cs_scatter[ll] + macroscopic_cs_absorb[ll]);
+
+    double rn0;
+    double rn1;
+    SIMD_NAME(random_numbers)(pkey[ll], master_key, counter[ll]++, &rn0,
+                              &rn1);
+
+    const int absorb = (rn0 < p_absorb);
+    weight[ll] *= 1.0 - ((absorb) ? p_absorb : 0.0);
+    dead[ll] = absorb & (energy[ll] < MIN_ENERGY_OF_INTEREST);
+
+    const double mu_cm = 1.0 - 2.0 * rn1;
+    const double e_new = energy[ll] *
+                         (MASS_NO * MASS_NO + 2.0 * MASS_NO * mu_cm + 1.0) /
+                         ((MASS_NO + 1.0) * (MASS_NO + 1.0));
+    const double cos_theta =
+        0.5 * ((MASS_NO + 1.0) * sqrt(e_new / energy[ll]) -
+               (MASS_NO - 1.0) * sqrt(energy[ll] / e_new));
+    const double sin_theta = sqrt(1.0 - cos_theta * cos_theta);
+    const double omega_x_new =
+        (omega_x[ll] * cos_theta - omega_y[ll] * sin_theta);
+    const double omega_y_new =
+        (omega_x[ll] * sin_theta + omega_y[ll] * cos_theta);
+    omega_x[ll] = (absorb) ? omega_x[ll] : omega_x_new;
+    omega_y[ll] = (absorb) ? omega_y[ll] : omega_y_new;
+    energy[ll] = (absorb) ? energy[ll] : e_new;
+  }
+
+  // The searches diverge, so each lane searches from its own previous entry
+  for (int ll = 0; ll < SIMD_LANES; ++ll) {
+    if (unionized_table) {
+      cs_entry(unionized_table, energy[ll], &scatter_cs_index[ll]);
+      absorb_cs_index[ll] = scatter_cs_index[ll];
+    } else {
+      cs_entry(cs_scatter_table, energy[ll], &scatter_cs_index[ll]);
+      cs_entry(cs_absorb_table, energy[ll], &absorb_cs_index[ll]);
+    }
+  }
+
+  // Gather the entries found and interpolate the cross sections
+  if (unionized_table) {
+    const double* keys = unionized_table->keys;
+    const double* values = unionized_table->values;
+    const int nreactions = unionized_table->nreactions;
+#pragma omp simd
+    for (int ll = 0; ll < SIMD_LANES; ++ll) {
+      const int ind = scatter_cs_index[ll];
+      const int lower = ind * nreactions;
+      const int upper = lower + nreactions;
+      const double fraction =
+          (energy[ll] - keys[ind]) / (keys[ind + 1] - keys[ind]);
+      microscopic_cs_scatter[ll] =
+          values[lower + SCATTER_REACTION] +
+          fraction * (values[upper + SCATTER_REACTION] -
+                      values[lower + SCATTER_REACTION]);
+      microscopic_cs_absorb[ll] =
+          values[lower + ABSORB_REACTION] +
+          fraction * (values[upper + ABSORB_REACTION] -
+                      values[lower + ABSORB_REACTION]);
+    }
+  } else {
+    const double* scatter_keys = cs_scatter_table->keys;
+    const double* scatter_values = cs_scatter_table->values;
+    const double* absorb_keys = cs_absorb_table->keys;
+    const double* absorb_values = cs_absorb_table->values;
+#pragma omp simd
+    for (int ll = 0; ll < SIMD_LANES; ++ll) {
+      const int si = scatter_cs_index[ll];
+      const int ai = absorb_cs_index[ll];
+      microscopic_cs_scatter[ll] =
+          scatter_values[si] +
+          ((energy[ll] - scatter_keys[si]) /
+           (scatter_keys[si + 1] - scatter_keys[si])) *
+              (scatter_values[si + 1] - scatter_values[si]);
+      microscopic_cs_absorb[ll] =
+          absorb_values[ai] +
+          ((energy[ll] - absorb_keys[ai]) /
+           (absorb_keys[ai + 1] - absorb_keys[ai])) *
+              (absorb_values[ai + 1] - absorb_values[ai]);
+    }
+  }
+
+  // Re-sample the mean free paths to collision at the new cross sections
+#pragma omp simd
+  for (int ll = 0; ll < SIMD_LANES; ++ll) {
+    macroscopic_cs_scatter[ll] =
+        number_density[ll] * microscopic_cs_scatter[ll] * BARNS;
+    macroscopic_cs_absorb[ll] =
+        number_density[ll] * microscopic_cs_absorb[ll] * BARNS;
+
+    double rn0;
+    double rn1;
+    SIMD_NAME(random_numbers)(pkey[ll], master_key, counter[ll], &rn0, &rn1);
+    mfp_to_collision[ll] =
+        -SIMD_NAME(simd_log)(rn0) / macroscopic_cs_scatter[ll];
+    dt_to_census[ll] -= distance[ll] / speed[ll];
+    speed[ll] = sqrt((2.0 * energy[ll] * eV_TO_J) / PARTICLE_MASS);
+  }
+
+  for (int ll = 0; ll < nlanes; ++ll) {
+    const int pid = pids[ll];
+    Particle* particle = &particles[pid];
+    if (!scalar_flux_tally) {
+      scalar_flux[ll] = 0.0;
+    }
+    particle->x = x[ll];
+    particle->y = y[ll];
+    particle->weight = weight[ll];
+
+    // Absorbed particles below the energy of interest tally and stop
+    if (dead[ll]) {
+      particle->dead = 1;
+      state->counter[pid] = counter[ll];
+      update_tallies(nx, x_off, y_off, particle, inv_ntotal_particles,
+                     energy_deposition[ll], scalar_flux[ll],
+                     energy_deposition_tally, scalar_flux_tally, options);
+      state->energy_deposition[pid] = 0.0;
+      state->scalar_flux[pid] = 0.0;
+      continue;
+    }
+
+    particle->omega_x = omega_x[ll];
+    particle->omega_y = omega_y[ll];
+    particle->energy = energy[ll];
+    particle->mfp_to_collision = mfp_to_collision[ll];
+    particle->dt_to_census = dt_to_census[ll];
+    state->counter[pid] = counter[ll] + 1;
+    state->microscopic_cs_scatter[pid] = microscopic_cs_scatter[ll];
+    state->microscopic_cs_absorb[pid] = microscopic_cs_absorb[ll];
+    state->macroscopic_cs_scatter[pid] = macroscopic_cs_scatter[ll];
+    state->macroscopic_cs_absorb[pid] = macroscopic_cs_absorb[ll];
+    state->speed[pid] = speed[ll];
+    state->energy_deposition[pid] = energy_deposition[ll];
+    state->scalar_flux[pid] = scalar_flux[ll];
+    state->scatter_cs_index[pid] = scatter_cs_index[ll];
+    state->absorb_cs_index[pid] = absorb_cs_index[ll];
+  }
+}
+
+// Handles the facet events of a batch of particles, as facet_event, with the
+// reflections at the problem boundary masked to the lanes that reach it. The
+// tallies and the densities of the new cells are fetched lane by lane.
+static void SIMD_NAME(facet_batch)(
+    const int global_nx, const int global_ny, const int nx, const int ny,
+    const int x_off, const int y_off, const double inv_ntotal_particles,
+    const int* pids, const int nlanes, const double* density,
+    Particle* particles, EventState* state, double* energy_deposition_tally,
+    double* scalar_flux_tally, const TransportOptions* options) {
+
+  double x[SIMD_LANES];
+  double y[SIMD_LANES];
+  double omega_x[SIMD_LANES];
+  double omega_y[SIMD_LANES];
+  double energy[SIMD_LANES];
+  double weight[SIMD_LANES];
+  double mfp_to_collision[SIMD_LANES];
+  double dt_to_census[SIMD_LANES];
+  double distance[SIMD_LANES];
+  double speed[SIMD_LANES];
+  double cell_mfp[SIMD_LANES];
+  double number_density[SIMD_LANES];
+  double microscopic_cs_scatter[SIMD_LANES];
+  double microscopic_cs_absorb[SIMD_LANES];
+  double energy_deposition[SIMD_LANES];
+  double scalar_flux[SIMD_LANES];
+  int cellx[SIMD_LANES];
+  int celly[SIMD_LANES];
+  int x_facet[SIMD_LANES];
+
+  int lane_pids[SIMD_LANES];
+  SIMD_NAME(fill_lanes)(pids, nlanes, lane_pids);
+
+#pragma omp simd
+  for (int ll = 0; ll < SIMD_LANES; ++ll) {
+    const int pid = lane_pids[ll];
+    const Particle* particle = &particles[pid];
+    x[ll] = particle->x;
+    y[ll] = particle->y;
+    omega_x[ll] = particle->omega_x;
+    omega_y[ll] = particle->omega_y;
+    energy[ll] = particle->energy;
+    weight[ll] = particle->weight;
+    mfp_to_collision[ll] = particle->mfp_to_collision;
+    dt_to_census[ll] = particle->dt_to_census;
+    cellx[ll] = particle->cellx;
+    celly[ll] = particle->celly;
+    distance[ll] = state->distance_to_event[pid];
+    speed[ll] = state->speed[pid];
+    cell_mfp[ll] = state->cell_mfp[pid];
+    x_facet[ll] = state->x_facet[pid];
+    number_density[ll] = state->number_density[pid];
+    microscopic_cs_scatter[ll] = state->microscopic_cs_scatter[pid];
+    microscopic_cs_absorb[ll] = state->microscopic_cs_absorb[pid];
+    energy_deposition[ll] = state->energy_deposition[pid];
+    scalar_flux[ll] = state->scalar_flux[pid];
+  }
+
+  int next_cellx[SIMD_LANES];
+  int next_celly[SIMD_LANES];
+
+#pragma omp simd
+  for (int ll = 0; ll < SIMD_LANES; ++ll) {
+    mfp_to_collision[ll] -= (distance[ll] / cell_mfp[ll]);
+    dt_to_census[ll] -= (distance[ll] / speed[ll]);
+    energy_deposition[ll] += SIMD_NAME(energy_deposition)(
+        energy[ll], weight[ll], distance[ll], number_density[ll],
+        microscopic_cs_absorb[ll],
+        microscopic_cs_scatter[ll] + microscopic_cs_absorb[ll]);
+
+    // The flux is accumulated in every lane, and only kept when it is tallied
+    scalar_flux[ll] += weight[ll] * distance[ll];
+    x[ll] += distance[ll] * omega_x[ll];
+    y[ll] += distance[ll] * omega_y[ll];
+
+    // A particle reaching the problem boundary reflects, and otherwise steps
+    // into the next cell along the axis of the facet
+    const int forward_x = (omega_x[ll] > 0.0);
+    const int backward_x = (omega_x[ll] < 0.0);
+    const int forward_y = (omega_y[ll] > 0.0);
+    const int backward_y = (omega_y[ll] < 0.0);
+    const int reflect_x =
+        x_facet[ll] & ((forward_x & (cellx[ll] >= global_nx - 1)) |
+                       (backward_x & (cellx[ll] <= 0)));
+    const int reflect_y =
+        (!x_facet[ll]) & ((forward_y & (celly[ll] >= global_ny - 1)) |
+                          (backward_y & (celly[ll] <= 0)));
+    next_cellx[ll] =
+        cellx[ll] + ((x_facet[ll] & !reflect_x) ? forward_x - backward_x : 0);
+    next_celly[ll] = celly[ll] +
+                     ((!x_facet[ll] & !reflect_y) ? forward_y - backward_y : 0);
+    omega_x[ll] = (reflect_x) ? -omega_x[ll] : omega_x[ll];
+    omega_y[ll] = (reflect_y) ? -omega_y[ll] : omega_y[ll];
+  }
+
+  for (int ll = 0; ll < nlanes; ++ll) {
+    const int pid = pids[ll];
+    Particle* particle = &particles[pid];
+    if (!scalar_flux_tally) {
+      scalar_flux[ll] = 0.0;
+    }
+    particle->x = x[ll];
+    particle->y = y[ll];
+    particle->omega_x = omega_x[ll];
+    particle->omega_y = omega_y[ll];
+    particle->mfp_to_collision = mfp_to_collision[ll];
+    particle->dt_to_census = dt_to_census[ll];
+
+    // Update tallies as we leave a tally cell or the rank
+    const int leaves_rank =
+        (next_cellx[ll] < x_off || next_cellx[ll] >= x_off + nx ||
+         next_celly[ll] < y_off || next_celly[ll] >= y_off + ny);
+    if (leaves_rank ||
+        enters_tally_cell(cellx[ll], celly[ll], next_cellx[ll], next_celly[ll],
+                          options)) {
+      update_tallies(nx, x_off, y_off, particle, inv_ntotal_particles,
+                     energy_deposition[ll], scalar_flux[ll],
+                     energy_deposition_tally, scalar_flux_tally, options);
+      energy_deposition[ll] = 0.0;
+      scalar_flux[ll] = 0.0;
+    }
+    particle->cellx = next_cellx[ll];
+    particle->celly = next_celly[ll];
+    state->energy_deposition[pid] = energy_deposition[ll];
+    state->scalar_flux[pid] = scalar_flux[ll];
+
+    // Particles that leave the rank are classified as dead next sweep
+    if (leaves_rank) {
+      send_and_mark_particle(pid, particle);
+      continue;
+    }
+
+    cell_densities(density,
+                   (next_celly[ll] - y_off) * nx + (next_cellx[ll] - x_off),
+                   &state->local_density[pid], &state->number_density[pid],
+                   options);
+    state->macroscopic_cs_scatter[pid] = state->number_density[pid] *
+                                         microscopic_cs_scatter[ll] * BARNS;
+    state->macroscopic_cs_absorb[pid] = state->number_density[pid] *
+                                        microscopic_cs_absorb[ll] * BARNS;
+  }
+}
+
+#undef SIMD_LANES
+#undef SIMD_NAME
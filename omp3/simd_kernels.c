@@ -0,0 +1,165 @@
+#include "neutral.h"
+#include "../../comms.h"
+#include "../../shared.h"
+#include "../neutral_interface.h"
+#include <math.h>
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// The key schedule parity of the Threefry generator
+#define THREEFRY_PARITY UINT64_C(0x1BD11BDAA9FC1A22)
+
+// Four rounds of the Threefry2x64 generator followed by the injection of the
+// key schedule, rotating by r0 to r3 bits in turn
+#define THREEFRY_ROUND(x0, x1, r)                                              \
+  x0 += x1;                                                                    \
+  x1 = (x1 << (r)) | (x1 >> (64 - (r)));                                       \
+  x1 ^= x0;
+#define THREEFRY_ROUNDS(x0, x1, ks, injection, r0, r1, r2, r3)                 \
+  THREEFRY_ROUND(x0, x1, r0)                                                   \
+  THREEFRY_ROUND(x0, x1, r1)                                                   \
+  THREEFRY_ROUND(x0, x1, r2)                                                   \
+  THREEFRY_ROUND(x0, x1, r3)                                                   \
+  x0 += ks[(injection) % 3];                                                   \
+  x1 += ks[((injection) + 1) % 3] + (injection);
+
+// GCC compiles a variant of the kernels for each x86 instruction set, and
+// other compilers a single variant for the instruction set of the build
+#if defined(__GNUC__) && !defined(__clang__) && !defined(__INTEL_COMPILER) && \
+    (defined(__x86_64__) || defined(__i386__))
+#define SIMD_TARGETS
+
+#pragma GCC push_options
+#pragma GCC target("arch=skylake-avx512,prefer-vector-width=512")
+#define SIMD_LANES 8
+#define SIMD_NAME(name) name##_avx512
+#include "simd_batch.h"
+#pragma GCC pop_options
+
+#pragma GCC push_options
+#pragma GCC target("arch=haswell")
+#define SIMD_LANES 4
+#define SIMD_NAME(name) name##_avx2
+#include "simd_batch.h"
+#pragma GCC pop_options
+
+#define DISPATCH_BATCH(kernel, ...)                                            \
+  if (simd_lanes == 8) {                                                       \
+    kernel##_avx512(__VA_ARGS__);                                              \
+  } else {                                                                     \
+    kernel##_avx2(__VA_ARGS__);                                                \
+  }
+
+#else
+
+#define SIMD_LANES 8
+#define SIMD_NAME(name) name##_generic
+#include "simd_batch.h"
+
+#define DISPATCH_BATCH(kernel, ...) kernel##_generic(__VA_ARGS__);
+
+#endif
+
+// Selects the SIMD kernels of the widest instruction set the CPU supports,
+// returning their lanes, or 0 when only the scalar kernels can run
+int select_simd_kernels(void) {
+
+  static int lanes = -1;
+  if (lanes >= 0) {
+    return lanes;
+  }
+
+  const char* isa = "the build";
+#ifdef SIMD_TARGETS
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f")) {
+    lanes = 8;
+    isa = "AVX-512";
+  } else if (__builtin_cpu_supports("avx2")) {
+    lanes = 4;
+    isa = "AVX2";
+  } else {
+    lanes = 0;
+  }
+#else
+  lanes = 8;
+#endif
+
+  if (lanes) {
+    printf("SIMD kernels of %d lanes for %s\n", lanes, isa);
+  } else {
+    printf("No SIMD kernels for this CPU, using the scalar kernels\n");
+  }
+
+  return lanes;
+}
+
+// Determines the next event that each live particle will encounter, a batch
+// of particles at a time
+void classify_events_simd(const int global_nx, const int pad, const int x_off,
+                          const int y_off, const int nlive, const int* live,
+                          Particle* particles, const double* edgex,
+                          const double* edgey, EventState* state,
+                          const TransportOptions* options) {
+
+  const int simd_lanes = options->simd_lanes;
+  const int nbatches = (nlive + simd_lanes - 1) / simd_lanes;
+
+#pragma omp parallel for
+  for (int bb = 0; bb < nbatches; ++bb) {
+    const int first = bb * simd_lanes;
+    const int nlanes = min(simd_lanes, nlive - first);
+    DISPATCH_BATCH(classify_batch, global_nx, pad, x_off, y_off,
+                   &live[first], nlanes, particles, edgex, edgey, state)
+  }
+}
+
+// Handles the collision events of the queued particles, a batch of particles
+// at a time
+void collision_events_simd(
+    const int nx, const int x_off, const int y_off, const uint64_t master_key,
+    const double inv_ntotal_particles, const int nqueue, const int* queue,
+    const CrossSection* cs_scatter_table, const CrossSection* cs_absorb_table,
+    Particle* particles, EventState* state, double* energy_deposition_tally,
+    double* scalar_flux_tally, const TransportOptions* options) {
+
+  const int simd_lanes = options->simd_lanes;
+  const int nbatches = (nqueue + simd_lanes - 1) / simd_lanes;
+
+#pragma omp parallel for
+  for (int bb = 0; bb < nbatches; ++bb) {
+    const int first = bb * simd_lanes;
+    const int nlanes = min(simd_lanes, nqueue - first);
+    DISPATCH_BATCH(collision_batch, nx, x_off, y_off, master_key,
+                   inv_ntotal_particles, &queue[first], nlanes,
+                   cs_scatter_table, cs_absorb_table, particles, state,
+                   energy_deposition_tally, scalar_flux_tally, options)
+  }
+}
+
+// Handles the facet events of the queued particles, a batch of particles at a
+// time
+void facet_events_simd(const int global_nx, const int global_ny, const int nx,
+                       const int ny, const int x_off, const int y_off,
+                       const double inv_ntotal_particles, const int nqueue,
+                       const int* queue, const double* density,
+                       Particle* particles, EventState* state,
+                       double* energy_deposition_tally,
+                       double* scalar_flux_tally,
+                       const TransportOptions* options) {
+
+  const int simd_lanes = options->simd_lanes;
+  const int nbatches = (nqueue + simd_lanes - 1) / simd_lanes;
+
+#pragma omp parallel for
+  for (int bb = 0; bb < nbatches; ++bb) {
+    const int first = bb * simd_lanes;
+    const int nlanes = min(simd_lanes, nqueue - first);
+    DISPATCH_BATCH(facet_batch, global_nx, global_ny, nx, ny, x_off, y_off,
+                   inv_ntotal_particles, &queue[first], nlanes, density,
+                   particles, state, energy_deposition_tally,
+                   scalar_flux_tally, options)
+  }
+}
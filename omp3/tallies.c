@@ -0,0 +1,138 @@
+#include "neutral.h"
+#include "../../comms.h"
+#include "../../shared.h"
+#include "../neutral_interface.h"
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// The private tally buffer of each thread, NULL when tallying atomically
+TallyBuffer* private_tally = NULL;
+
+// Adds the contents of a tally buffer to the tallies and empties it
+static void flush_tally_buffer(TallyBuffer* buffer, double* tally,
+                               double* flux_tally);
+
+// Maps the columns and rows of the global mesh onto a coarse tally mesh of
+// tally_nx x tally_ny cells that each gather a block of whole cells
+void map_tally_mesh(const int global_nx, const int global_ny,
+                    TransportOptions* options) {
+
+  if (options->tally_cell_x) {
+    return;
+  }
+
+  const int coarse_nx = options->tally_nx;
+  const int coarse_ny = options->tally_ny;
+  int* tally_cell_x = (int*)malloc(sizeof(int) * global_nx);
+  int* tally_cell_y = (int*)malloc(sizeof(int) * global_ny);
+  if (!tally_cell_x || !tally_cell_y) {
+    TERMINATE("Could not allocate the tally mesh map.\n");
+  }
+
+  // The cells are shared out between the tally cells as evenly as possible
+  for (int ii = 0; ii < global_nx; ++ii) {
+    tally_cell_x[ii] = (int)(((int64_t)ii * coarse_nx) / global_nx);
+  }
+  for (int jj = 0; jj < global_ny; ++jj) {
+    tally_cell_y[jj] = (int)(((int64_t)jj * coarse_ny) / global_ny);
+  }
+  options->tally_cell_x = tally_cell_x;
+  options->tally_cell_y = tally_cell_y;
+
+  printf("Tally mesh of %dx%d cells over %dx%d cells\n", coarse_nx, coarse_ny,
+         global_nx, global_ny);
+}
+
+// Allocates a private tally buffer for every thread
+void initialise_tally_buffers(void) {
+
+#pragma omp parallel
+  {
+    // Allocated inside the parallel region so the pages are local to the
+    // thread that uses them
+    if (!private_tally) {
+      private_tally = (TallyBuffer*)malloc(sizeof(TallyBuffer));
+      if (!private_tally) {
+        TERMINATE("Could not allocate the private tally buffer.\n");
+      }
+      private_tally->cells = (int*)malloc(sizeof(int) * TALLY_BUFFER_SIZE);
+      private_tally->values =
+          (double*)malloc(sizeof(double) * TALLY_BUFFER_SIZE);
+      private_tally->flux_values =
+          (double*)malloc(sizeof(double) * TALLY_BUFFER_SIZE);
+      private_tally->used = (int*)malloc(sizeof(int) * TALLY_BUFFER_SIZE);
+      if (!private_tally->cells || !private_tally->values ||
+          !private_tally->flux_values || !private_tally->used) {
+        TERMINATE("Could not allocate the private tally buffer.\n");
+      }
+      for (int ii = 0; ii < TALLY_BUFFER_SIZE; ++ii) {
+        private_tally->cells[ii] = -1;
+      }
+      private_tally->nused = 0;
+      private_tally->nflushes = 0;
+    }
+  }
+}
+
+// Adds a contribution to the private tally buffer, flushing the buffer into
+// the tallies when it becomes too full to probe efficiently
+void add_to_tally_buffer(TallyBuffer* buffer, const int cell,
+                         const double value, const double flux_value,
+                         double* tally, double* flux_tally) {
+
+  // Fibonacci hashing spreads neighbouring cells across the buffer, taking
+  // the high bits of the product, which depend on every bit of the cell
+  int slot = ((uint32_t)cell * 2654435769u) >> (32 - TALLY_BUFFER_BITS);
+  while (buffer->cells[slot] != cell) {
+    if (buffer->cells[slot] == -1) {
+      if (buffer->nused >= TALLY_BUFFER_SIZE / 2) {
+        flush_tally_buffer(buffer, tally, flux_tally);
+        buffer->nflushes++;
+      }
+      buffer->cells[slot] = cell;
+      buffer->values[slot] = 0.0;
+      buffer->flux_values[slot] = 0.0;
+      buffer->used[buffer->nused++] = slot;
+      break;
+    }
+    slot = (slot + 1) & (TALLY_BUFFER_SIZE - 1);
+  }
+
+  // The flux shares the slot of the energy deposition, so costs no probing
+  buffer->values[slot] += value;
+  buffer->flux_values[slot] += flux_value;
+}
+
+// Reduces the private tally buffers of all threads into the tallies
+void reduce_tally_buffers(double* tally, double* flux_tally) {
+
+  uint64_t nflushes = 0;
+
+#pragma omp parallel reduction(+ : nflushes)
+  {
+    flush_tally_buffer(private_tally, tally, flux_tally);
+    nflushes += private_tally->nflushes;
+    private_tally->nflushes = 0;
+  }
+
+  printf("Tally buffer overflows %llu\n", (unsigned long long)nflushes);
+}
+
+// Adds the contents of a tally buffer to the tallies and empties it
+static void flush_tally_buffer(TallyBuffer* buffer, double* tally,
+                               double* flux_tally) {
+
+  // Each thread contributes once per distinct cell rather than once per event
+  for (int ii = 0; ii < buffer->nused; ++ii) {
+    const int slot = buffer->used[ii];
+#pragma omp atomic update
+    tally[buffer->cells[slot]] += buffer->values[slot];
+    if (flux_tally) {
+#pragma omp atomic update
+      flux_tally[buffer->cells[slot]] += buffer->flux_values[slot];
+    }
+    buffer->cells[slot] = -1;
+  }
+  buffer->nused = 0;
+}
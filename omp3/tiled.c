@@ -0,0 +1,150 @@
+#include "neutral.h"
+#include "../../comms.h"
+#include "../../shared.h"
+#include "../neutral_interface.h"
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// Handles the current active batch of particles tile by tile, handing
+// particles off between tile queues as they cross tile borders
+void handle_particles_tiled(
+    const int global_nx, const int global_ny, const int nx, const int ny,
+    const uint64_t master_key, const int pad, const int x_off, const int y_off,
+    const int initial, const double dt, const int* neighbours,
+    const double* density, const double* edgex, const double* edgey,
+    uint64_t* facets, uint64_t* collisions, const int ntotal_particles,
+    const int nparticles_to_process, Particle* particles,
+    CrossSection* cs_scatter_table, CrossSection* cs_absorb_table,
+    double* energy_deposition_tally, double* scalar_flux_tally,
+    const TransportOptions* options) {
+
+  const int tile_size = options->tile_size;
+  const int ntiles_x = (nx + tile_size - 1) / tile_size;
+  const int ntiles_y = (ny + tile_size - 1) / tile_size;
+  const int ntiles = ntiles_x * ntiles_y;
+
+  EventState state;
+  allocate_event_state(&state, nparticles_to_process);
+
+  // The particles waiting for a tile, the queues and the tile of each particle,
+  // where finished particles are assigned to an extra tile that is never run
+  int* pending = (int*)malloc(sizeof(int) * nparticles_to_process);
+  int* queue = (int*)malloc(sizeof(int) * nparticles_to_process);
+  int* tile = (int*)malloc(sizeof(int) * nparticles_to_process);
+  int* nqueue = (int*)malloc(sizeof(int) * (ntiles + 1));
+  int* queue_off = (int*)malloc(sizeof(int) * (ntiles + 1));
+  if (!pending || !queue || !tile || !nqueue || !queue_off) {
+    TERMINATE("Could not allocate the tile queues.\n");
+  }
+
+  const double inv_ntotal_particles = 1.0 / (double)ntotal_particles;
+
+  const uint64_t nparticles = initialise_event_state(
+      nx, master_key, pad, x_off, y_off, initial, dt, density,
+      nparticles_to_process, particles, cs_scatter_table, cs_absorb_table,
+      &state, pending, options);
+
+#pragma omp parallel for
+  for (int pp = 0; pp < nparticles_to_process; ++pp) {
+    const Particle* particle = &particles[pp];
+    tile[pp] = ntiles;
+    if (!particle->dead) {
+      tile[pp] = ((particle->celly - y_off) / tile_size) * ntiles_x +
+                 (particle->cellx - x_off) / tile_size;
+    }
+  }
+
+  uint64_t nfacets = 0;
+  uint64_t ncollisions = 0;
+  uint64_t nhandoffs = 0;
+  int nrounds = 0;
+  int npending = nparticles_to_process;
+
+  while (npending > 0) {
+    START_PROFILING(&compute_profile);
+    partition_particles(npending, pending, tile, ntiles + 1, queue, nqueue);
+    queue_off[0] = 0;
+    for (int tt = 0; tt < ntiles; ++tt) {
+      queue_off[tt + 1] = queue_off[tt] + nqueue[tt];
+    }
+    STOP_PROFILING(&compute_profile, "partition tiles");
+
+    // The queued particles have been copied out, so the pending list is free
+    // to collect the particles handed off during this round
+    int nsent = 0;
+
+    START_PROFILING(&compute_profile);
+#pragma omp parallel for schedule(dynamic) reduction(+ : nfacets, ncollisions)
+    for (int tt = 0; tt < ntiles; ++tt) {
+      if (!nqueue[tt]) {
+        continue;
+      }
+
+      // Determine the global bounds of the tile's cells
+      const int tile_x0 = x_off + (tt % ntiles_x) * tile_size;
+      const int tile_y0 = y_off + (tt / ntiles_x) * tile_size;
+      const int tile_x1 = min(tile_x0 + tile_size, x_off + nx);
+      const int tile_y1 = min(tile_y0 + tile_size, y_off + ny);
+
+      for (int ii = queue_off[tt]; ii < queue_off[tt + 1]; ++ii) {
+        const int pid = queue[ii];
+        Particle* particle = &particles[pid];
+
+        const int result = track_particle_history(
+            global_nx, global_ny, nx, ny, master_key, pad, x_off, y_off,
+            inv_ntotal_particles, pid, tile_x0, tile_y0, tile_x1, tile_y1,
+            neighbours, density, edgex, edgey, particle, cs_scatter_table,
+            cs_absorb_table, energy_deposition_tally, scalar_flux_tally,
+            &state.counter[pid], &state.local_density[pid],
+            &state.energy_deposition[pid], &state.scalar_flux[pid],
+            &state.number_density[pid], &state.microscopic_cs_scatter[pid],
+            &state.microscopic_cs_absorb[pid],
+            &state.macroscopic_cs_scatter[pid],
+            &state.macroscopic_cs_absorb[pid], &state.scatter_cs_index[pid],
+            &state.absorb_cs_index[pid], &state.speed[pid], &nfacets,
+            &ncollisions, options);
+
+        if (result != PARTICLE_SENT) {
+          continue;
+        }
+
+        // Particles leaving the rank are sent to the neighbour instead
+        if (particle->cellx < x_off || particle->cellx >= x_off + nx ||
+            particle->celly < y_off || particle->celly >= y_off + ny) {
+          send_and_mark_particle(pid, particle);
+          continue;
+        }
+
+        tile[pid] = ((particle->celly - y_off) / tile_size) * ntiles_x +
+                    (particle->cellx - x_off) / tile_size;
+
+        int off;
+#pragma omp atomic capture
+        off = nsent++;
+        pending[off] = pid;
+      }
+    }
+    STOP_PROFILING(&compute_profile, "track tiles");
+
+    nhandoffs += nsent;
+    npending = nsent;
+    nrounds++;
+  }
+
+  // Store a total number of facets and collisions
+  *facets += nfacets;
+  *collisions += ncollisions;
+
+  printf("Particles  %llu\n", (unsigned long long)nparticles);
+  printf("Tiles      %d of %dx%d cells, %d rounds, %llu hand-offs\n", ntiles,
+         tile_size, tile_size, nrounds, (unsigned long long)nhandoffs);
+
+  free(pending);
+  free(queue);
+  free(tile);
+  free(nqueue);
+  free(queue_off);
+  store_cs_indices(nparticles_to_process, particles, &state);
+  deallocate_event_state(&state);
+}
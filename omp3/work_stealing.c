@@ -0,0 +1,164 @@
+#include "neutral.h"
+#include "../../comms.h"
+#include "../../shared.h"
+#include "../neutral_interface.h"
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// Takes the next chunk from the head of a thread's own deque
+static int pop_chunk(ChunkDeque* deque);
+
+// Moves half of the remaining chunks of another thread into our own deque
+static int steal_chunks(ChunkDeque* deques, const int nthreads,
+                        const int tid);
+
+// Handles the current active batch of particles, balancing the load between
+// threads by stealing chunks of particles
+void handle_particles_work_stealing(
+    const int global_nx, const int global_ny, const int nx, const int ny,
+    const uint64_t master_key, const int pad, const int x_off, const int y_off,
+    const int initial, const double dt, const int* neighbours,
+    const double* density, const double* edgex, const double* edgey,
+    uint64_t* facets, uint64_t* collisions, const int ntotal_particles,
+    const int nparticles_to_process, Particle* particles,
+    CrossSection* cs_scatter_table, CrossSection* cs_absorb_table,
+    double* energy_deposition_tally, double* scalar_flux_tally,
+    const TransportOptions* options) {
+
+  int nthreads = 0;
+#pragma omp parallel
+  { nthreads = omp_get_num_threads(); }
+
+  ChunkDeque* deques = (ChunkDeque*)malloc(sizeof(ChunkDeque) * nthreads);
+  double* busy_time = (double*)malloc(sizeof(double) * nthreads);
+  double* idle_time = (double*)malloc(sizeof(double) * nthreads);
+  int* nsteals = (int*)malloc(sizeof(int) * nthreads);
+  if (!deques || !busy_time || !idle_time || !nsteals) {
+    TERMINATE("Could not allocate the work-stealing deques.\n");
+  }
+
+  // Each thread starts with the same contiguous slice the static scheduler
+  // would give it, so the balanced case does not need to steal
+  const int nchunks =
+      (nparticles_to_process + PARTICLE_CHUNK_SIZE - 1) / PARTICLE_CHUNK_SIZE;
+  const int nc_per_thread = nchunks / nthreads;
+  const int nc_remainder = nchunks % nthreads;
+  for (int tt = 0; tt < nthreads; ++tt) {
+    omp_init_lock(&deques[tt].lock);
+    deques[tt].head = tt * nc_per_thread + min(tt, nc_remainder);
+    deques[tt].tail = deques[tt].head + nc_per_thread + (tt < nc_remainder);
+  }
+
+  uint64_t nfacets = 0;
+  uint64_t ncollisions = 0;
+  uint64_t nparticles = 0;
+
+#pragma omp parallel reduction(+ : nfacets, ncollisions, nparticles)
+  {
+    const int tid = omp_get_thread_num();
+    const double start = omp_get_wtime();
+    double busy = 0.0;
+    nsteals[tid] = 0;
+
+    while (1) {
+      const int chunk = pop_chunk(&deques[tid]);
+      if (chunk < 0) {
+        // Chunks only ever move to an active thief, so once every deque is
+        // empty the remaining work is already owned by a running thread
+        if (!steal_chunks(deques, nthreads, tid)) {
+          break;
+        }
+        nsteals[tid]++;
+        continue;
+      }
+
+      const double chunk_start = omp_get_wtime();
+      const int particles_off = chunk * PARTICLE_CHUNK_SIZE;
+      const int particles_end =
+          min(particles_off + PARTICLE_CHUNK_SIZE, nparticles_to_process);
+
+      for (int pid = particles_off; pid < particles_end; ++pid) {
+        Particle* particle = &particles[pid];
+
+        if (particle->dead) {
+          continue;
+        }
+
+        nparticles++;
+
+        handle_particle(global_nx, global_ny, nx, ny, master_key, pad, x_off,
+                        y_off, initial, dt, pid, neighbours, density, edgex,
+                        edgey, ntotal_particles, particle, cs_scatter_table,
+                        cs_absorb_table, energy_deposition_tally,
+                        scalar_flux_tally, &nfacets, &ncollisions, options);
+      }
+
+      busy += omp_get_wtime() - chunk_start;
+    }
+
+    // Idle time includes the wait for the slowest thread to finish
+#pragma omp barrier
+    busy_time[tid] = busy;
+    idle_time[tid] = (omp_get_wtime() - start) - busy;
+  }
+
+  // Store a total number of facets and collisions
+  *facets += nfacets;
+  *collisions += ncollisions;
+
+  printf("Particles  %llu\n", (unsigned long long)nparticles);
+  for (int tt = 0; tt < nthreads; ++tt) {
+    printf("Thread %4d busy %.4fs idle %.4fs steals %d\n", tt, busy_time[tt],
+           idle_time[tt], nsteals[tt]);
+  }
+
+  for (int tt = 0; tt < nthreads; ++tt) {
+    omp_destroy_lock(&deques[tt].lock);
+  }
+  free(deques);
+  free(busy_time);
+  free(idle_time);
+  free(nsteals);
+}
+
+// Takes the next chunk from the head of a thread's own deque
+static int pop_chunk(ChunkDeque* deque) {
+  int chunk = -1;
+  omp_set_lock(&deque->lock);
+  if (deque->head < deque->tail) {
+    chunk = deque->head++;
+  }
+  omp_unset_lock(&deque->lock);
+  return chunk;
+}
+
+// Moves half of the remaining chunks of another thread into our own deque
+static int steal_chunks(ChunkDeque* deques, const int nthreads,
+                        const int tid) {
+
+  // Visit the other threads in turn, starting from our neighbour
+  for (int vv = 1; vv < nthreads; ++vv) {
+    ChunkDeque* victim = &deques[(tid + vv) % nthreads];
+
+    omp_set_lock(&victim->lock);
+    const int nremaining = victim->tail - victim->head;
+    const int tail = victim->tail;
+    const int head = tail - (nremaining + 1) / 2;
+    if (nremaining > 0) {
+      victim->tail = head;
+    }
+    omp_unset_lock(&victim->lock);
+
+    if (nremaining > 0) {
+      // Only one lock is held at a time, and thieves never add to our deque
+      omp_set_lock(&deques[tid].lock);
+      deques[tid].head = head;
+      deques[tid].tail = tail;
+      omp_unset_lock(&deques[tid].lock);
+      return 1;
+    }
+  }
+
+  return 0;
+}
@@ -23,9 +23,11 @@ void solve_transport_2d(
     const int* neighbours, Particle* particles, const double* density,
     const double* edgex, const double* edgey, const double* edgedx,
     const double* edgedy, CrossSection* cs_scatter_table,
-    CrossSection* cs_absorb_table, double* energy_deposition_tally,
+    CrossSection* cs_absorb_table, CrossSection* cs_unionized_table,
+    double* energy_deposition_tally, double* scalar_flux_tally,
     uint64_t* reduce_array0, uint64_t* reduce_array1, uint64_t* reduce_array2,
-    uint64_t* facet_events, uint64_t* collision_events) {
+    uint64_t* facet_events, uint64_t* collision_events,
+    TransportOptions* options) {
 
   if (!(*nparticles)) {
     printf("Out of particles\n");
@@ -0,0 +1,162 @@
+#include "neutral_data.h"
+#include "../comms.h"
+#include "../shared.h"
+#include "neutral_interface.h"
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef MPI
+#include "mpi.h"
+#endif
+
+// The number of cells reduced by each message of the tally reduction
+#define TALLY_REDUCTION_CHUNK (1 << 16)
+
+#ifdef MPI
+// A reduction of a tally onto the master rank that may still be in flight
+typedef struct {
+  double* tally;    // The tally the result is added to on the master rank
+  double* send;     // The contributions of the rank while in flight
+  double* recv;     // The reduced contributions on the master rank
+  MPI_Request* requests;
+  int nrequests;
+  int ncells;
+
+} TallyReduction;
+
+// The reductions of the energy deposition and scalar flux tallies
+static TallyReduction energy_reduction;
+static TallyReduction flux_reduction;
+
+// Hands the contributions gathered in a tally to a reduction onto the master
+// rank, emptying the tally to gather the contributions that follow
+static void start_tally_reduction(TallyReduction* reduction, double* tally,
+                                  const int ncells, const int rank);
+
+// Waits for a reduction and adds its result to the tally on the master rank
+static void complete_tally_reduction(TallyReduction* reduction,
+                                     const int rank);
+#endif
+
+// Gives every rank the whole mesh, in place of the spatial decomposition
+void replicate_domain(Mesh* mesh) {
+  mesh->x_off = 0;
+  mesh->y_off = 0;
+  mesh->local_nx = mesh->global_nx + 2 * mesh->pad;
+  mesh->local_ny = mesh->global_ny + 2 * mesh->pad;
+
+  // No particle ever leaves the rank
+  for (int nn = 0; nn < NNEIGHBOURS; ++nn) {
+    mesh->neighbours[nn] = EDGE;
+  }
+}
+
+// Starts reducing the tallies of the ranks replicating the domain onto the
+// master rank, completing the reduction unless it is nonblocking
+void reduce_replicated_tallies(NeutralData* neutral_data, Mesh* mesh,
+                               const int nonblocking) {
+
+#ifdef MPI
+  const double reduction_start = omp_get_wtime();
+  const int ncells = neutral_data->tally_nx * neutral_data->tally_ny;
+
+  // The previous reduction must finish before its buffers are reused
+  complete_replicated_tallies(neutral_data);
+
+  START_PROFILING(&comms_profile);
+  start_tally_reduction(&energy_reduction,
+                        neutral_data->energy_deposition_tally, ncells,
+                        mesh->rank);
+  if (neutral_data->scalar_flux_tally) {
+    start_tally_reduction(&flux_reduction, neutral_data->scalar_flux_tally,
+                          ncells, mesh->rank);
+  }
+  STOP_PROFILING(&comms_profile, "reduce tallies");
+
+  if (!nonblocking) {
+    complete_replicated_tallies(neutral_data);
+  }
+
+  if (mesh->rank == MASTER) {
+    printf("Tally reduction %d chunks %s in %.4fs\n",
+           (ncells + TALLY_REDUCTION_CHUNK - 1) / TALLY_REDUCTION_CHUNK,
+           nonblocking ? "posted" : "reduced",
+           omp_get_wtime() - reduction_start);
+  }
+#endif
+}
+
+// Completes any outstanding reduction of the replicated tallies
+void complete_replicated_tallies(NeutralData* neutral_data) {
+#ifdef MPI
+  int rank;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+  START_PROFILING(&comms_profile);
+  complete_tally_reduction(&energy_reduction, rank);
+  complete_tally_reduction(&flux_reduction, rank);
+  STOP_PROFILING(&comms_profile, "complete tally reduction");
+#endif
+}
+
+#ifdef MPI
+// Hands the contributions gathered in a tally to a reduction onto the master
+// rank, emptying the tally to gather the contributions that follow
+static void start_tally_reduction(TallyReduction* reduction, double* tally,
+                                  const int ncells, const int rank) {
+
+  const int nchunks =
+      (ncells + TALLY_REDUCTION_CHUNK - 1) / TALLY_REDUCTION_CHUNK;
+
+  if (reduction->ncells != ncells) {
+    free(reduction->send);
+    free(reduction->recv);
+    free(reduction->requests);
+    reduction->send = (double*)malloc(sizeof(double) * ncells);
+    reduction->recv = (double*)malloc(sizeof(double) * ncells);
+    reduction->requests = (MPI_Request*)malloc(sizeof(MPI_Request) * nchunks);
+    if (!reduction->send || !reduction->recv || !reduction->requests) {
+      TERMINATE("Could not allocate the tally reduction buffers.\n");
+    }
+    reduction->ncells = ncells;
+  }
+
+  // The master rank's tally holds the totals reduced so far, which are added
+  // back to it along with the contributions of every rank
+#pragma omp parallel for
+  for (int ii = 0; ii < ncells; ++ii) {
+    reduction->send[ii] = tally[ii];
+    tally[ii] = 0.0;
+  }
+
+  for (int cc = 0; cc < nchunks; ++cc) {
+    const int off = cc * TALLY_REDUCTION_CHUNK;
+    const int len = min(TALLY_REDUCTION_CHUNK, ncells - off);
+    MPI_Ireduce(&reduction->send[off], &reduction->recv[off], len, MPI_DOUBLE,
+                MPI_SUM, MASTER, MPI_COMM_WORLD, &reduction->requests[cc]);
+  }
+  reduction->tally = tally;
+  reduction->nrequests = nchunks;
+}
+
+// Waits for a reduction and adds its result to the tally on the master rank
+static void complete_tally_reduction(TallyReduction* reduction,
+                                     const int rank) {
+
+  if (!reduction->nrequests) {
+    return;
+  }
+
+  MPI_Waitall(reduction->nrequests, reduction->requests, MPI_STATUSES_IGNORE);
+  reduction->nrequests = 0;
+
+  if (rank == MASTER) {
+#pragma omp parallel for
+    for (int ii = 0; ii < reduction->ncells; ++ii) {
+      reduction->tally[ii] += reduction->recv[ii];
+    }
+  }
+}
+#endif